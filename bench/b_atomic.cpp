@@ -0,0 +1,53 @@
+#include <cstdint>
+#include <vector>
+#include "rts.hpp"
+#include "bench.hpp"
+
+// atomic adds through vectors of pointers, one lock-prefixed add per active lane ("per lane") against atomic_add,
+// which merges the lanes that share an address first. a shared counter has every lane on one address, a small
+// histogram has a few addresses per vector, and a wide one almost never repeats an address within a vector.
+
+using namespace rts;
+
+static const int reps = 10;
+
+template <class P>
+static void per_lane(const P & p, const vec<std::int32_t> & v, const vec<bool> & mask) {
+  for (std::uint32_t m = movemask(mask);m;) {
+    const int j = bscf(m);
+    detail::atomic_lane<std::int32_t>::fetch_add(p.get(j), v.get(j));
+  }
+}
+
+static void run(const char * name, const soa_vector<std::int32_t> & keys, std::size_t buckets) {
+  std::vector<std::int32_t> counts(buckets, 0);
+  const int w = int(keys.size() >> default_isa::shift);
+  const vec<std::int32_t> one(1);
+  const vec<bool> all(true);
+  std::printf("%s\n", name);
+  double baseline = bench::best_ns(reps, [&] {
+    for (int i=0;i<w;++i) per_lane(vec<based_ptr<std::int32_t>>(counts.data(), keys.vget(i)), one, all);
+    bench::keep(counts);
+  });
+  bench::report("per lane", baseline, keys.size());
+  bench::report("atomic_add", bench::best_ns(reps, [&] {
+    for (int i=0;i<w;++i) atomic_add(vec<based_ptr<std::int32_t>>(counts.data(), keys.vget(i)), one, all);
+    bench::keep(counts);
+  }), keys.size(), baseline);
+}
+
+int main() {
+  const std::size_t n = std::size_t(1) << 20;
+  soa_vector<std::int32_t> zero(n), small(n), wide(n);
+  std::uint32_t seed = 1;
+  for (std::size_t i=0;i<n;++i) {
+    seed = seed * 1664525u + 1013904223u;
+    zero.put(i, 0);
+    small.put(i, std::int32_t(seed >> 30));
+    wide.put(i, std::int32_t(seed >> 16));
+  }
+  run("counter", zero, 1);
+  run("histogram of 4", small, 4);
+  run("histogram of 65536", wide, 1 << 16);
+  return 0;
+}
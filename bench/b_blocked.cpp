@@ -0,0 +1,24 @@
+#include "rts.hpp"
+#include "bench.hpp"
+
+// wide expressions over columns much larger than the caches, whole-array versus tiled evaluation
+
+using namespace rts;
+
+static const int reps = 20;
+
+int main() {
+  const std::size_t n = std::size_t(1) << 22; // 16MiB per column
+  soa_vector<float> a(n, 1.f), b(n, 2.f), c(n, 3.f), d(n, 4.f), e(n, 5.f), f(n, 6.f), z(n);
+  auto vexp = [](const vec<float> & v) { return vec_math::exp(v); };
+  auto expr = map(a * b - c, vexp) + d * e / f;
+
+  const cache_sizes & caches = system_caches();
+  std::printf("l1d %zuKiB, l2 %zuKiB, l3 %zuKiB, default tile %d vectors\n", caches.l1d >> 10, caches.l2 >> 10, caches.l3 >> 10, default_tile<decltype(expr)>());
+
+  double baseline = bench::best_ns(reps, [&] { z = expr; bench::keep(z); });
+  bench::report("operator =", baseline, n);
+  bench::report("blocked_assign", bench::best_ns(reps, [&] { blocked_assign(z, expr); bench::keep(z); }), n, baseline);
+  bench::report("blocked_assign, 16 vector tiles", bench::best_ns(reps, [&] { blocked_assign(z, expr, 16); bench::keep(z); }), n, baseline);
+  return 0;
+}
@@ -0,0 +1,59 @@
+#include <vector>
+#include "rts.hpp"
+#include "bench.hpp"
+
+// one varying branch per vector over data whose lanes agree on it (a sorted ramp split once) or disagree (a random
+// split), small enough to stay in cache. "masked" always narrows and restores the execution mask, as every if_ used
+// to; if_ and cif_ skip that whenever the active lanes agree.
+
+using namespace rts;
+
+static const int reps = 20;
+static const int passes = 256;
+
+template <class Branch>
+static void kernel(const soa_vector<float> & in, soa_vector<float> & out, Branch branch) {
+  const int w = int(in.size() >> default_isa::shift);
+  for (int p=0;p<passes;++p) {
+    for (int i=0;i<w;++i) {
+      const varying<float> x(in.vget(i));
+      varying<float> y = 0.f;
+      branch(x > 0.5f, [&] { y = x * x + 2.f; }, [&] { y = x - 1.f; });
+      out.vdata()[i] = y.data;
+    }
+    bench::keep(out);
+  }
+}
+
+static void run(const char * name, const soa_vector<float> & in) {
+  const std::size_t n = in.size();
+  soa_vector<float> out(n);
+  std::printf("%s\n", name);
+  double baseline = bench::best_ns(reps, [&] {
+    kernel(in, out, [](const varying<bool> & c, auto t, auto f) { detail::divergent_if(c.data, t, f); });
+    bench::keep(out);
+  });
+  bench::report("masked", baseline, n * passes);
+  bench::report("if_", bench::best_ns(reps, [&] {
+    kernel(in, out, [](const varying<bool> & c, auto t, auto f) { if_(c, t, f); });
+    bench::keep(out);
+  }), n * passes, baseline);
+  bench::report("cif_", bench::best_ns(reps, [&] {
+    kernel(in, out, [](const varying<bool> & c, auto t, auto f) { cif_(c, t, f); });
+    bench::keep(out);
+  }), n * passes, baseline);
+}
+
+int main() {
+  const std::size_t n = std::size_t(1) << 12;
+  soa_vector<float> coherent(n), divergent(n);
+  std::uint32_t seed = 1;
+  for (std::size_t i=0;i<n;++i) {
+    seed = seed * 1664525u + 1013904223u;
+    coherent.put(i, float(i) / float(n));
+    divergent.put(i, float(seed >> 8) / float(1 << 24));
+  }
+  run("coherent", coherent);
+  run("divergent", divergent);
+  return 0;
+}
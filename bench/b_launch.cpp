@@ -0,0 +1,45 @@
+#include <cstdint>
+#include "rts.hpp"
+#include "bench.hpp"
+
+// mandelbrot escape counts as an SPMD kernel over one row, run row by row on the calling thread against one task per
+// row launched across the default worker pool.
+
+using namespace rts;
+
+static const int reps = 10;
+static const int width = 1024, height = 512, max_iterations = 256;
+
+static void row(int y, std::int32_t * out) {
+  const float ci = -1.f + 2.f * float(y) / float(height);
+  foreach(0, width, [&](varying<std::int32_t> x) {
+    varying<float> cr;
+    for (int l=0;l<default_isa::width;++l) cr.put(l, -2.f + 3.f * float(x.get(l)) / float(width));
+    varying<float> zr = 0.f, zi = 0.f;
+    varying<std::int32_t> n = 0;
+    while_([&] { return (n < max_iterations) & (zr * zr + zi * zi <= 4.f); }, [&] {
+      const varying<float> t = zr * zr - zi * zi + cr;
+      zi = 2.f * zr * zi + ci;
+      zr = t;
+      n += 1;
+    });
+    for (int l=0;l<default_isa::width;++l) out[x.get(l)] = n.get(l);
+  });
+}
+
+int main() {
+  static std::int32_t a[width * height], b[width * height];
+  const std::size_t pixels = std::size_t(width) * height;
+  std::printf("mandelbrot, %u workers and the caller\n", default_worker_pool().size());
+  const double baseline = bench::best_ns(reps, [&] {
+    for (int y=0;y<height;++y) row(y, a + y * width);
+    bench::keep(a);
+  });
+  bench::report("one thread", baseline, pixels);
+  bench::report("launch", bench::best_ns(reps, [&] {
+    launch(height, [&](std::size_t y, std::size_t) { row(int(y), b + y * width); });
+    bench::keep(b);
+  }), pixels, baseline);
+  for (std::size_t i=0;i<pixels;++i) if (a[i] != b[i]) { std::printf("mismatch at %zu\n", i); return 1; }
+  return 0;
+}
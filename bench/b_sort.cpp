@@ -0,0 +1,37 @@
+#include <algorithm>
+#include <vector>
+#include "rts.hpp"
+#include "bench.hpp"
+
+// sorting random 32-bit keys, std::sort against the sorting network merge sort. every run first restores the input.
+
+using namespace rts;
+
+static const int reps = 10;
+
+template <class T>
+static void run(const char * name, const std::vector<T> & input) {
+  const std::size_t n = input.size();
+  std::vector<T> v(n);
+  soa_vector<T> x(n);
+  std::printf("%s\n", name);
+  double baseline = bench::best_ns(reps, [&] { std::copy(input.begin(), input.end(), v.begin()); std::sort(v.begin(), v.end()); bench::keep(v); });
+  bench::report("std::sort", baseline, n);
+  bench::report("sort", bench::best_ns(reps, [&] { for (std::size_t i=0;i<n;++i) x.put(i, input[i]); sort(x); bench::keep(x); }), n, baseline);
+  bench::report("argsort", bench::best_ns(reps, [&] { auto p = argsort(x); bench::keep(p); }), n, baseline);
+}
+
+int main() {
+  const std::size_t n = std::size_t(1) << 22;
+  std::vector<float> f(n);
+  std::vector<std::int32_t> k(n);
+  std::uint32_t seed = 1;
+  for (std::size_t i=0;i<n;++i) {
+    seed = seed * 1664525u + 1013904223u;
+    k[i] = std::int32_t(seed);
+    f[i] = float(seed >> 8) * 0.001f;
+  }
+  run("float", f);
+  run("int32", k);
+  return 0;
+}
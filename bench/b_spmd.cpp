@@ -0,0 +1,110 @@
+#include <cstdint>
+#include "rts.hpp"
+#include "bench.hpp"
+
+// the execution mask in thread_local storage against the mask in an spmd_context, on mandelbrot escape counts (a
+// divergent loop) and on a cache-resident branch over random data (a divergent if), the latter also with a stand-in for
+// a call the compiler cannot see into in one arm. the varying arithmetic is shared; only the masking differs.
+
+using namespace rts;
+
+static const int reps = 10;
+static const int width = 512, height = 256, max_iterations = 256;
+static const int passes = 256;
+
+static void mandelbrot_tls(const soa_vector<float> & re, float im, std::int32_t * out) {
+  for (int i=0;i<width/default_isa::width;++i) {
+    const varying<float> cr(re.vget(i)), ci = im;
+    varying<float> zr = 0.f, zi = 0.f;
+    varying<std::int32_t> n = 0;
+    while_([&] { return (n < max_iterations) & (zr * zr + zi * zi <= 4.f); }, [&] {
+      const varying<float> t = zr * zr - zi * zi + cr;
+      zi = 2.f * zr * zi + ci;
+      zr = t;
+      n += 1;
+    });
+    for (int l=0;l<default_isa::width;++l) out[i * default_isa::width + l] = n.get(l);
+  }
+}
+
+static void mandelbrot_context(const soa_vector<float> & re, float im, std::int32_t * out) {
+  spmd_context<> ctx;
+  for (int i=0;i<width/default_isa::width;++i) {
+    const varying<float> cr(re.vget(i)), ci = im;
+    varying<float> zr = 0.f, zi = 0.f;
+    varying<std::int32_t> n = 0;
+    ctx.while_([&] { return (n < max_iterations) & (zr * zr + zi * zi <= 4.f); }, [&] {
+      const varying<float> t = zr * zr - zi * zi + cr;
+      ctx.assign(zi, 2.f * zr * zi + ci);
+      ctx.assign(zr, t);
+      ctx.assign(n, n + 1);
+    });
+    for (int l=0;l<default_isa::width;++l) out[i * default_isa::width + l] = n.get(l);
+  }
+}
+
+template <class K>
+static double mandelbrot(K kernel, const soa_vector<float> & re, std::int32_t * out) {
+  return bench::best_ns(reps, [&] {
+    for (int y=0;y<height;++y) kernel(re, -1.f + 2.f * float(y) / float(height), out + y * width);
+    bench::keep(out);
+  });
+}
+
+template <bool opaque>
+static void branch_tls(const soa_vector<float> & in, soa_vector<float> & out) {
+  const int w = int(in.size() >> default_isa::shift);
+  for (int p=0;p<passes;++p) {
+    for (int i=0;i<w;++i) {
+      const varying<float> x(in.vget(i));
+      varying<float> y = 0.f;
+      if_(x > 0.5f, [&] { y = x * x + 2.f; if (opaque) bench::clobber(); }, [&] { y = x - 1.f; });
+      out.vdata()[i] = y.data;
+    }
+    bench::keep(out);
+  }
+}
+
+template <bool opaque>
+static void branch_context(const soa_vector<float> & in, soa_vector<float> & out) {
+  const int w = int(in.size() >> default_isa::shift);
+  spmd_context<> ctx;
+  for (int p=0;p<passes;++p) {
+    for (int i=0;i<w;++i) {
+      const varying<float> x(in.vget(i));
+      varying<float> y = 0.f;
+      ctx.if_(x > 0.5f, [&] { ctx.assign(y, x * x + 2.f); if (opaque) bench::clobber(); }, [&] { ctx.assign(y, x - 1.f); });
+      out.vdata()[i] = y.data;
+    }
+    bench::keep(out);
+  }
+}
+
+int main() {
+  soa_vector<float> re(width);
+  for (int x=0;x<width;++x) re.put(std::size_t(x), -2.f + 3.f * float(x) / float(width));
+  static std::int32_t a[width * height], b[width * height];
+  const std::size_t pixels = std::size_t(width) * height;
+  std::printf("mandelbrot\n");
+  const double baseline = mandelbrot(mandelbrot_tls, re, a);
+  bench::report("thread_local mask", baseline, pixels);
+  bench::report("spmd_context", mandelbrot(mandelbrot_context, re, b), pixels, baseline);
+  for (std::size_t i=0;i<pixels;++i) if (a[i] != b[i]) { std::printf("mismatch at %zu\n", i); return 1; }
+
+  const std::size_t n = 4096;
+  soa_vector<float> in(n), out(n);
+  std::uint32_t seed = 1;
+  for (std::size_t i=0;i<n;++i) {
+    seed = seed * 1664525u + 1013904223u;
+    in.put(i, float(seed >> 8) / float(1 << 24));
+  }
+  std::printf("divergent branch\n");
+  const double branch = bench::best_ns(reps, [&] { branch_tls<false>(in, out); });
+  bench::report("thread_local mask", branch, n * passes);
+  bench::report("spmd_context", bench::best_ns(reps, [&] { branch_context<false>(in, out); }), n * passes, branch);
+  std::printf("divergent branch, opaque call\n");
+  const double opaque = bench::best_ns(reps, [&] { branch_tls<true>(in, out); });
+  bench::report("thread_local mask", opaque, n * passes);
+  bench::report("spmd_context", bench::best_ns(reps, [&] { branch_context<true>(in, out); }), n * passes, opaque);
+  return 0;
+}
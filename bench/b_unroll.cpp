@@ -0,0 +1,34 @@
+#include "rts.hpp"
+#include "bench.hpp"
+
+// throughput of exp/log heavy soa expressions, one vector per step versus several
+
+using namespace rts;
+
+static const int reps = 500;
+
+template <class T, class E>
+void run(const char * title, T & z, const E & e, std::size_t n) {
+  std::printf("%s\n", title);
+  double baseline = bench::best_ns(reps, [&] { z = e; bench::keep(z); });
+  bench::report("  operator =", baseline, n);
+  bench::report("  unrolled_assign<1>", bench::best_ns(reps, [&] { unrolled_assign<1>(z, e); bench::keep(z); }), n, baseline);
+  bench::report("  unrolled_assign<2>", bench::best_ns(reps, [&] { unrolled_assign<2>(z, e); bench::keep(z); }), n, baseline);
+  bench::report("  unrolled_assign<4>", bench::best_ns(reps, [&] { unrolled_assign<4>(z, e); bench::keep(z); }), n, baseline);
+  bench::report("  unrolled_assign<8>", bench::best_ns(reps, [&] { unrolled_assign<8>(z, e); bench::keep(z); }), n, baseline);
+}
+
+int main() {
+  const std::size_t n = 2048; // three columns stay resident in L1
+  soa_vector<float> x(n), y(n), z(n);
+  for (std::size_t i=0;i<n;++i) {
+    x.put(i, 0.5f + float(i % 97) / 97.f);
+    y.put(i, 1.5f + float(i % 89) / 89.f);
+  }
+  auto vexp = [](const vec<float> & v) { return vec_math::exp(v); };
+  auto vlog = [](const vec<float> & v) { return vec_math::log(v); };
+
+  run("vec_math kernels: exp(x) * log(y) + log(x * y)", z, map(x, vexp) * map(y, vlog) + map(x * y, vlog), n);
+  run("lane-wise <cmath>: exp(x) * log(y) + log(x * y)", z, exp(x) * log(y) + log(x * y), n);
+  return 0;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <limits>
+#include <memory>
+
+/// @file bench.hpp
+/// @brief a minimal wall clock harness for the programs in bench/
+
+namespace bench {
+  /// keep the compiler from discarding the computation behind @p t
+  template <class T>
+  inline void keep(const T & t) {
+  #if defined(_MSC_VER)
+    static volatile const void * sink;
+    sink = std::addressof(t);
+  #else
+    asm volatile("" : : "r"(std::addressof(t)) : "memory");
+  #endif
+  }
+
+  /// make the compiler assume any memory may have changed, as a call to a function it cannot see into would
+  inline void clobber() {
+  #if defined(_MSC_VER)
+    _ReadWriteBarrier();
+  #else
+    asm volatile("" : : : "memory");
+  #endif
+  }
+
+  /// the fastest of @p reps runs of @p f, in nanoseconds
+  template <class F>
+  double best_ns(int reps, F f) {
+    double best = std::numeric_limits<double>::infinity();
+    for (int r=0;r<reps;++r) {
+      auto start = std::chrono::steady_clock::now();
+      f();
+      std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+      best = std::min(best, elapsed.count());
+    }
+    return best;
+  }
+
+  /// print one result as nanoseconds per element, and the speedup over @p baseline_ns if given
+  inline void report(const char * name, double ns, std::size_t n, double baseline_ns = 0) {
+    if (baseline_ns > 0)
+      std::printf("%-40s %9.3f ns/element %6.2fx\n", name, ns / double(n), baseline_ns / ns);
+    else
+      std::printf("%-40s %9.3f ns/element\n", name, ns / double(n));
+  }
+}
@@ -1,10 +1,27 @@
 #pragma once
 
 #include "rts/enumerators.hpp"
+#include "rts/aligned.hpp"
+#include "rts/atomic.hpp"
 #include "rts/attribute.hpp"
 #include "rts/chrono.hpp"
+#include "rts/columnar.hpp"
 #include "rts/cpu.hpp"
+#include "rts/cross_lane.hpp"
+#include "rts/filter.hpp"
+#include "rts/gather.hpp"
+#include "rts/interleave.hpp"
+#include "rts/launch.hpp"
+#include "rts/mapped_soa.hpp"
+#include "rts/parallel.hpp"
+#include "rts/pool.hpp"
+#include "rts/reduce.hpp"
 #include "rts/soa.hpp"
+#include "rts/soa_table.hpp"
+#include "rts/soa_vector.hpp"
+#include "rts/soa_view.hpp"
+#include "rts/sort.hpp"
+#include "rts/spmd.hpp"
 #include "rts/varying.hpp"
 #include "rts/vec.hpp"
 #include "rts/vec_intrinsics.hpp"
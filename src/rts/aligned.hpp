@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include "platform.hpp"
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+/// @file rts/aligned.hpp
+/// @brief over-aligned heap allocation
+
+namespace rts {
+  /// allocate @p bytes aligned to @p alignment, which must be a power of two. throws @p std::bad_alloc on failure.
+  static inline void * aligned_allocate(std::size_t bytes, std::size_t alignment) {
+    if (alignment < sizeof(void*)) alignment = sizeof(void*);
+    if (bytes == 0) bytes = alignment;
+  #ifdef _WIN32
+    void * p = _aligned_malloc(bytes, alignment);
+    if (p == nullptr) throw std::bad_alloc();
+  #else
+    void * p = nullptr;
+    if (posix_memalign(&p, alignment, bytes) != 0) throw std::bad_alloc();
+  #endif
+    return p;
+  }
+
+  /// release memory obtained from @p aligned_allocate
+  static inline void aligned_deallocate(void * p) noexcept {
+  #ifdef _WIN32
+    _aligned_free(p);
+  #else
+    std::free(p);
+  #endif
+  }
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "varying.hpp"
+#include "x86.hpp"
+
+/// @file rts/atomic.hpp
+/// @brief atomic read-modify-write through vectors of pointers
+///
+/// Each operation touches memory only for the active lanes, and lanes that point at the same address are merged
+/// first: their operands are combined in lane order and the address gets a single atomic. Every lane still gets back
+/// the value it would have seen had the lanes gone one at a time, lowest first, so a coherent update of a shared
+/// counter costs one atomic rather than one per lane.
+
+namespace rts {
+  namespace detail {
+    template <class T>
+    struct atomic_lane {
+      static_assert(std::is_trivially_copyable<T>::value && (sizeof(T) == 4 || sizeof(T) == 8), "atomics need 32 or 64 bit lanes");
+    #ifdef _MSC_VER
+      using word = typename std::conditional<sizeof(T) == 4, long, __int64>::type;
+      static RTS_ALWAYS_INLINE long cas(volatile long * p, long desired, long expected) noexcept { return _InterlockedCompareExchange(p, desired, expected); }
+      static RTS_ALWAYS_INLINE __int64 cas(volatile __int64 * p, __int64 desired, __int64 expected) noexcept { return _InterlockedCompareExchange64(p, desired, expected); }
+    #endif
+
+      static RTS_ALWAYS_INLINE T load(const T * p) noexcept {
+      #ifdef _MSC_VER
+        const word w = *reinterpret_cast<const volatile word *>(p);
+        T result;
+        std::memcpy(&result, &w, sizeof(T));
+        return result;
+      #else
+        T result;
+        __atomic_load(p, &result, __ATOMIC_ACQUIRE);
+        return result;
+      #endif
+      }
+
+      // replace *p by desired if it still holds expected, otherwise load what it does hold into expected
+      static RTS_ALWAYS_INLINE bool compare_exchange(T * p, T & expected, T desired) noexcept {
+      #ifdef _MSC_VER
+        word e, d;
+        std::memcpy(&e, &expected, sizeof(T));
+        std::memcpy(&d, &desired, sizeof(T));
+        const word seen = cas(reinterpret_cast<volatile word *>(p), d, e);
+        if (seen == e) return true;
+        std::memcpy(&expected, &seen, sizeof(T));
+        return false;
+      #else
+        return __atomic_compare_exchange(p, &expected, &desired, false, __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE);
+      #endif
+      }
+
+      // atomically replace *p by f(*p), returning the old value. nothing is written when f leaves the value alone
+      template <class F>
+      static RTS_ALWAYS_INLINE T update(T * p, F f) {
+        T seen = load(p);
+        for (;;) {
+          const T next = f(seen);
+          if (next == seen || compare_exchange(p, seen, next)) return seen;
+        }
+      }
+
+      template <class U = T, typename std::enable_if<std::is_integral<U>::value, int>::type = 0>
+      static RTS_ALWAYS_INLINE T fetch_add(T * p, T v) noexcept {
+      #ifdef _MSC_VER
+        return update(p, [v](T x) { return T(x + v); });
+      #else
+        return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST);
+      #endif
+      }
+
+      template <class U = T, typename std::enable_if<!std::is_integral<U>::value, int>::type = 0>
+      static RTS_ALWAYS_INLINE T fetch_add(T * p, T v) noexcept {
+        return update(p, [v](T x) { return T(x + v); });
+      }
+    };
+
+    // the lanes of m that point where lane i does
+    template <class T, class A>
+    RTS_ALWAYS_INLINE std::uint32_t same_address(const vec<T*,A> & p, int i, std::uint32_t m) noexcept {
+      const T * a = p.get(i);
+      std::uint32_t result = 0;
+      while (m) {
+        const int j = bscf(m);
+        result |= std::uint32_t(p.get(j) == a) << j;
+      }
+      return result;
+    }
+
+    template <class T, class A>
+    RTS_ALWAYS_INLINE std::uint32_t same_address(const vec<based_ptr<T>,A> & p, int i, std::uint32_t m) noexcept {
+      using offsets = typename vec<based_ptr<T>,A>::offsets;
+      return movemask(p.offset == offsets(p.offset.get(i))) & m;
+    }
+
+    // combine the active lanes of v that share an address with op, issue(address, combined) once per address for the
+    // old value there, and give each lane the old value combined with the lanes below it at the same address
+    template <class P, class T, class A, class Op, class Issue>
+    RTS_ALWAYS_INLINE vec<T,A> combine_lanes(const vec<P,A> & p, const vec<T,A> & v, const vec<bool,A> & mask, Op op, Issue issue) {
+      vec<T,A> result;
+      std::uint32_t m = movemask(mask);
+      while (m) {
+        const int i = bsf(m);
+        std::uint32_t lanes = same_address(p, i, m);
+        m &= ~lanes;
+        lanes &= lanes - 1;
+        if (!lanes) {
+          result.put(i, issue(p.get(i), v.get(i)));
+          continue;
+        }
+        T total = v.get(i);
+        for (std::uint32_t r = lanes;r;) total = op(total, v.get(bscf(r)));
+        T seen = issue(p.get(i), total);
+        result.put(i, seen);
+        seen = op(seen, v.get(i));
+        while (lanes) {
+          const int j = bscf(lanes);
+          result.put(j, seen);
+          seen = op(seen, v.get(j));
+        }
+      }
+      return result;
+    }
+
+    struct atomic_plus {
+      template <class T> RTS_ALWAYS_INLINE T operator()(T a, T b) const noexcept { return a + b; }
+    };
+
+    struct atomic_least {
+      template <class T> RTS_ALWAYS_INLINE T operator()(T a, T b) const noexcept { return b < a ? b : a; }
+    };
+
+    struct atomic_most {
+      template <class T> RTS_ALWAYS_INLINE T operator()(T a, T b) const noexcept { return a < b ? b : a; }
+    };
+  }
+
+  /// add @p v to what each active lane of @p p points at, returning the values they held before. lanes that share
+  /// an address are summed into one atomic, and see the old value plus the lanes below them.
+  template <class P, class T, class A>
+  vec<T,A> atomic_add(const vec<P,A> & p, const vec<T,A> & v, const vec<bool,A> & mask) {
+    return detail::combine_lanes(p, v, mask, detail::atomic_plus(), [](T * a, T x) {
+      return detail::atomic_lane<T>::fetch_add(a, x);
+    });
+  }
+
+  /// lower what each active lane of @p p points at to @p v, returning the values they held before
+  template <class P, class T, class A>
+  vec<T,A> atomic_min(const vec<P,A> & p, const vec<T,A> & v, const vec<bool,A> & mask) {
+    return detail::combine_lanes(p, v, mask, detail::atomic_least(), [](T * a, T x) {
+      return detail::atomic_lane<T>::update(a, [x](T y) { return detail::atomic_least()(y, x); });
+    });
+  }
+
+  /// raise what each active lane of @p p points at to @p v, returning the values they held before
+  template <class P, class T, class A>
+  vec<T,A> atomic_max(const vec<P,A> & p, const vec<T,A> & v, const vec<bool,A> & mask) {
+    return detail::combine_lanes(p, v, mask, detail::atomic_most(), [](T * a, T x) {
+      return detail::atomic_lane<T>::update(a, [x](T y) { return detail::atomic_most()(y, x); });
+    });
+  }
+
+  /// for each active lane of @p p, replace the value it points at by @p desired if it equals @p expected. returns the
+  /// values seen, so a lane succeeded where that equals @p expected. lanes sharing an address take turns, lowest first.
+  template <class P, class T, class A>
+  vec<T,A> compare_exchange(const vec<P,A> & p, const vec<T,A> & expected, const vec<T,A> & desired, const vec<bool,A> & mask) {
+    vec<T,A> result;
+    std::uint32_t m = movemask(mask);
+    while (m) {
+      const int i = bsf(m);
+      const std::uint32_t lanes = detail::same_address(p, i, m);
+      m &= ~lanes;
+      const auto run = [&](T x, bool record) {
+        for (std::uint32_t r = lanes;r;) {
+          const int j = bscf(r);
+          if (record) result.put(j, x);
+          if (x == expected.get(j)) x = desired.get(j);
+        }
+        return x;
+      };
+      run(detail::atomic_lane<T>::update(p.get(i), [&](T x) { return run(x, false); }), true);
+    }
+    return result;
+  }
+
+  /// @p atomic_add over the current @p execution_mask
+  template <class P, class T, class A>
+  RTS_ALWAYS_INLINE varying<T,A> atomic_add(const vec<P,A> & p, const varying<T,A> & v) {
+    return atomic_add(p, v.data, execution_mask<A>);
+  }
+
+  /// @p atomic_min over the current @p execution_mask
+  template <class P, class T, class A>
+  RTS_ALWAYS_INLINE varying<T,A> atomic_min(const vec<P,A> & p, const varying<T,A> & v) {
+    return atomic_min(p, v.data, execution_mask<A>);
+  }
+
+  /// @p atomic_max over the current @p execution_mask
+  template <class P, class T, class A>
+  RTS_ALWAYS_INLINE varying<T,A> atomic_max(const vec<P,A> & p, const varying<T,A> & v) {
+    return atomic_max(p, v.data, execution_mask<A>);
+  }
+
+  /// @p compare_exchange over the current @p execution_mask
+  template <class P, class T, class A>
+  RTS_ALWAYS_INLINE varying<T,A> compare_exchange(const vec<P,A> & p, const varying<T,A> & expected, const varying<T,A> & desired) {
+    return compare_exchange(p, expected.data, desired.data, execution_mask<A>);
+  }
+}
@@ -167,6 +167,14 @@
 #define RTS_ALWAYS_INLINE __forceinline
 #endif
 
+/// @def RTS_LIKELY(X)
+/// @brief the condition @p X is expected to hold, via gcc's @p __builtin_expect where available
+#if defined(__GNUC__) || defined(__clang__)
+#define RTS_LIKELY(X) __builtin_expect(!!(X),1)
+#else
+#define RTS_LIKELY(X) (X)
+#endif
+
 
 /// @def RTS_UNUSED
 /// @brief portable version of gcc's @p \__attribute__((unused))
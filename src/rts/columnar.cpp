@@ -0,0 +1,242 @@
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include "aligned.hpp"
+#include "columnar.hpp"
+
+#ifdef _WIN32
+#include <cstdlib>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace rts {
+  namespace columnar {
+    namespace {
+      const char magic[8] = { 'r','t','s','c','o','l',0,0 };
+      const std::uint32_t version = 1;
+      const std::uint32_t byte_order = 0x01020304;
+
+      [[noreturn]] void fail(const char * what) { throw std::system_error(errno, std::generic_category(), what); }
+      [[noreturn]] void corrupt(const char * what) { throw std::runtime_error(std::string("rts::columnar: ") + what); }
+    }
+
+    namespace detail {
+      std::size_t pack(const std::uint32_t * in, std::size_t n, int bits, std::uint64_t * out) noexcept {
+        const std::size_t words = packed_words(n, bits);
+        if (words == 0) return 0;
+        std::memset(out, 0, words * sizeof(std::uint64_t));
+        std::size_t bit = 0;
+        for (std::size_t i=0;i<n;++i, bit += std::size_t(bits)) {
+          const std::size_t w = bit >> 6;
+          const int shift = int(bit & 63);
+          out[w] |= std::uint64_t(in[i]) << shift;
+          if (shift + bits > 64) out[w + 1] |= std::uint64_t(in[i]) >> (64 - shift);
+        }
+        return words;
+      }
+
+      void unpack(const std::uint64_t * in, std::size_t n, int bits, std::uint32_t * out) noexcept {
+        if (bits == 0) {
+          std::memset(out, 0, n * sizeof(std::uint32_t));
+          return;
+        }
+        const std::uint64_t mask = (std::uint64_t(1) << bits) - 1;
+        std::size_t bit = 0;
+        for (std::size_t i=0;i<n;++i, bit += std::size_t(bits)) {
+          const std::size_t w = bit >> 6;
+          const int shift = int(bit & 63);
+          std::uint64_t v = in[w] >> shift;
+          if (shift + bits > 64) v |= in[w + 1] << (64 - shift);
+          out[i] = std::uint32_t(v & mask);
+        }
+      }
+    }
+
+    writer::writer(const char * path, std::uint32_t block_rows)
+    : file_(nullptr), offset_(0), rows_(0), block_rows_(block_rows) {
+      if (block_rows == 0 || block_rows % 64 != 0) throw std::invalid_argument("rts::columnar: block_rows must be a positive multiple of 64");
+      file_ = std::fopen(path, "wb");
+      if (file_ == nullptr) fail("fopen");
+      const file_header placeholder = {};
+      write(&placeholder, sizeof(placeholder));
+    }
+
+    writer::~writer() {
+      if (file_ != nullptr) {
+        try { close(); } catch (...) {}
+      }
+    }
+
+    void writer::write(const void * p, std::size_t bytes) {
+      if (bytes != 0 && std::fwrite(p, 1, bytes, file_) != bytes) fail("fwrite");
+      offset_ += bytes;
+    }
+
+    void writer::pad_to(std::size_t alignment) {
+      static const char zeros[64] = {};
+      std::size_t pad = std::size_t((alignment - offset_ % alignment) % alignment);
+      while (pad) {
+        const std::size_t k = pad < sizeof(zeros) ? pad : sizeof(zeros);
+        write(zeros, k);
+        pad -= k;
+      }
+    }
+
+    column_header & writer::begin_column(const char * name, std::size_t n, type t, encoding e, std::uint32_t alignment, bool stats) {
+      if (file_ == nullptr) throw std::logic_error("rts::columnar: writer is closed");
+      const std::size_t len = std::strlen(name);
+      if (len >= sizeof(column_header::name)) throw std::invalid_argument("rts::columnar: column name too long");
+      if (columns_.empty()) rows_ = n;
+      else if (rows_ != n) throw std::invalid_argument("rts::columnar: every column must have the same number of rows");
+
+      // the reader maps the file from its start, so aligning the offset aligns the address
+      pad_to(alignment > 64 ? alignment : 64);
+      column_header h = {};
+      std::memcpy(h.name, name, len);
+      h.type = std::uint8_t(t);
+      h.encoding = std::uint8_t(e);
+      h.has_stats = stats && n != 0;
+      h.alignment = alignment > 64 ? alignment : 64;
+      h.offset = offset_;
+      columns_.push_back(h);
+      return columns_.back();
+    }
+
+    void writer::close() {
+      if (file_ == nullptr) return;
+      std::FILE * f = file_;
+      pad_to(8);
+      file_header h = {};
+      std::memcpy(h.magic, magic, sizeof(magic));
+      h.version = version;
+      h.byte_order = byte_order;
+      h.rows = rows_;
+      h.columns = std::uint32_t(columns_.size());
+      h.block_rows = block_rows_;
+      h.directory = offset_;
+      try {
+        if (!columns_.empty()) write(columns_.data(), columns_.size() * sizeof(column_header));
+        if (std::fseek(f, 0, SEEK_SET) != 0) fail("fseek");
+        if (std::fwrite(&h, 1, sizeof(h), f) != sizeof(h)) fail("fwrite");
+      } catch (...) {
+        file_ = nullptr;
+        std::fclose(f);
+        throw;
+      }
+      file_ = nullptr;
+      if (std::fclose(f) != 0) fail("fclose");
+    }
+
+    reader::reader(const char * path) : base_(nullptr), bytes_(0), mapped_(false), header_(nullptr), columns_(nullptr) {
+    #ifdef _WIN32
+      std::FILE * f = std::fopen(path, "rb");
+      if (f == nullptr) fail("fopen");
+      std::fseek(f, 0, SEEK_END);
+      const long size = std::ftell(f);
+      std::fseek(f, 0, SEEK_SET);
+      if (size < 0) { std::fclose(f); fail("ftell"); }
+      bytes_ = std::size_t(size);
+      void * p = aligned_allocate(bytes_ ? bytes_ : 1, 4096);
+      const bool ok = std::fread(p, 1, bytes_, f) == bytes_;
+      std::fclose(f);
+      base_ = static_cast<const unsigned char *>(p);
+      if (!ok) { aligned_deallocate(p); fail("fread"); }
+    #else
+      int fd = open(path, O_RDONLY);
+      if (fd < 0) fail("open");
+      struct stat st;
+      if (fstat(fd, &st) != 0) {
+        int e = errno;
+        ::close(fd);
+        errno = e;
+        fail("fstat");
+      }
+      bytes_ = std::size_t(st.st_size);
+      if (bytes_ < sizeof(file_header)) {
+        ::close(fd);
+        corrupt("file too short");
+      }
+      void * p = mmap(nullptr, bytes_, PROT_READ, MAP_PRIVATE, fd, 0);
+      int e = errno;
+      ::close(fd);
+      if (p == MAP_FAILED) {
+        errno = e;
+        fail("mmap");
+      }
+      base_ = static_cast<const unsigned char *>(p);
+      mapped_ = true;
+    #endif
+      try {
+        validate(bytes_);
+      } catch (...) {
+        release();
+        throw;
+      }
+    }
+
+    reader::~reader() { release(); }
+
+    void reader::release() noexcept {
+      if (base_ == nullptr) return;
+    #ifdef _WIN32
+      aligned_deallocate(const_cast<unsigned char *>(base_));
+    #else
+      if (mapped_) munmap(const_cast<unsigned char *>(base_), bytes_);
+    #endif
+      base_ = nullptr;
+    }
+
+    void reader::validate(std::size_t n) {
+      if (n < sizeof(file_header)) corrupt("file too short");
+      header_ = reinterpret_cast<const file_header *>(base_);
+      if (std::memcmp(header_->magic, magic, sizeof(magic)) != 0) corrupt("bad magic");
+      if (header_->byte_order != byte_order) corrupt("file was written with the other byte order");
+      if (header_->version != version) corrupt("unsupported version");
+      if (header_->block_rows == 0 || header_->block_rows % 64 != 0) corrupt("bad block size");
+      const std::uint64_t dir = header_->directory;
+      if (dir % 8 != 0 || dir > n || (n - dir) / sizeof(column_header) < header_->columns) corrupt("bad directory");
+      columns_ = reinterpret_cast<const column_header *>(base_ + dir);
+      const std::uint64_t b = blocks();
+      for (std::uint32_t c=0;c<header_->columns;++c) {
+        const column_header & h = columns_[c];
+        const std::uint64_t size = h.type == std::uint8_t(type::float32) || h.type == std::uint8_t(type::int32) ? 4 : 0;
+        if (size == 0) corrupt("unknown column type");
+        if (h.offset > n || h.bytes > n - h.offset) corrupt("column data out of bounds");
+        if (h.encoding == std::uint8_t(encoding::plain)) {
+          // divide rather than multiply: rows comes from the file and rows * size may wrap
+          if (header_->rows > (n - h.offset) / size || h.bytes != header_->rows * size || h.offset % 64 != 0) corrupt("bad plain column");
+        } else if (h.encoding == std::uint8_t(encoding::bitpack) || h.encoding == std::uint8_t(encoding::delta)) {
+          if (h.type != std::uint8_t(type::int32)) corrupt("encoded column must be int32");
+          if (h.index % 8 != 0 || h.index > n || (n - h.index) / 8 < b + 1) corrupt("block index out of bounds");
+          const std::uint64_t * index = reinterpret_cast<const std::uint64_t *>(base_ + h.index);
+          for (std::uint64_t i=0;i<b;++i) {
+            const std::uint64_t rows_in_block = std::min<std::uint64_t>(header_->block_rows, header_->rows - i * header_->block_rows);
+            if (index[i] > index[i+1] || index[i+1] > h.bytes || index[i+1] - index[i] < sizeof(detail::block_header)) corrupt("bad block index");
+            detail::block_header bh;
+            std::memcpy(&bh, base_ + h.offset + index[i], sizeof(bh));
+            if (bh.bits > 32 || index[i+1] - index[i] < sizeof(bh) + 8 * detail::packed_words(std::size_t(rows_in_block), int(bh.bits)))
+              corrupt("bad block");
+          }
+        } else corrupt("unknown encoding");
+        if (h.has_stats && (h.stats % 8 != 0 || h.stats > n || (n - h.stats) / (2 * size) < b)) corrupt("stats out of bounds");
+      }
+    }
+
+    const column_header & reader::column(std::size_t c) const {
+      if (c >= columns()) throw std::out_of_range("rts::columnar: column out of range");
+      return columns_[c];
+    }
+
+    std::size_t reader::find(const char * name) const {
+      for (std::size_t c=0, e=columns();c<e;++c)
+        if (std::strncmp(columns_[c].name, name, sizeof(columns_[c].name)) == 0) return c;
+      throw std::out_of_range(std::string("rts::columnar: no column named ") + name);
+    }
+  }
+}
@@ -0,0 +1,330 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "soa.hpp"
+#include "soa_vector.hpp"
+
+/// @file rts/columnar.hpp
+/// @brief a self-describing binary file format for soa columns
+///
+/// A file is a 64 byte @p columnar::file_header, then each column's data, then a directory of
+/// @p columnar::column_header records. Every column holds the same number of rows, split into blocks of
+/// @p block_rows rows. A column is stored as one of these encodings:
+///
+/// - @p plain: the values as a raw array, starting on a 64 byte boundary. A reader hands these out in place.
+/// - @p bitpack: per block, the minimum and each value less the minimum, in the fewest bits that hold them all.
+/// - @p delta: per block, the first value and the zigzagged differences between neighbours, bit packed.
+///
+/// Encoded blocks are followed by a table of their offsets. A column may also carry the minimum and maximum
+/// of each block. Files are written in native byte order, and a reader rejects files of the other order.
+
+namespace rts {
+  namespace columnar {
+    /// element types a column can hold
+    enum class type : std::uint8_t { float32 = 1, int32 = 2 };
+
+    /// how a column's values are stored
+    enum class encoding : std::uint8_t {
+      plain = 0,   ///< raw values, readable in place
+      bitpack = 1, ///< frame of reference bit packing, int32 only
+      delta = 2    ///< bit packed zigzag deltas, int32 only. suits sorted or slowly changing columns
+    };
+
+    template <class T> struct type_of;
+    template <> struct type_of<float> { static const type value = type::float32; };
+    template <> struct type_of<std::int32_t> { static const type value = type::int32; };
+
+    /// rows per block unless the writer is told otherwise
+    static const std::uint32_t default_block_rows = 65536;
+
+    struct file_header {
+      char magic[8];             ///< "rtscol" followed by two zero bytes
+      std::uint32_t version;     ///< currently 1
+      std::uint32_t byte_order;  ///< 0x01020304 as written by the producer
+      std::uint64_t rows;
+      std::uint32_t columns;
+      std::uint32_t block_rows;  ///< a multiple of 64
+      std::uint64_t directory;   ///< offset of the first column_header
+      std::uint8_t reserved[24];
+    };
+
+    struct column_header {
+      char name[32];             ///< zero terminated
+      std::uint8_t type;         ///< a columnar::type
+      std::uint8_t encoding;     ///< a columnar::encoding
+      std::uint8_t has_stats;
+      std::uint8_t reserved0;
+      std::uint32_t alignment;   ///< of the data
+      std::uint64_t offset;      ///< of the data
+      std::uint64_t bytes;       ///< of the data
+      std::uint64_t index;       ///< of the block offset table for encoded columns, relative offsets from @p offset, 0 if plain
+      std::uint64_t stats;       ///< of the per block (min,max) pairs, 0 if none
+      std::uint8_t reserved1[8];
+    };
+
+    static_assert(sizeof(file_header) == 64, "file_header must be 64 bytes");
+    static_assert(sizeof(column_header) == 80, "column_header must be 80 bytes");
+
+    /// how @p writer stores a column
+    struct column_options {
+      columnar::encoding encoding = columnar::encoding::plain;
+      bool stats = true; ///< record the minimum and maximum of each block
+    };
+
+    namespace detail {
+      // pack n values of bits bits each, least significant first, into out. returns the number of words written
+      extern std::size_t pack(const std::uint32_t * in, std::size_t n, int bits, std::uint64_t * out) noexcept;
+      extern void unpack(const std::uint64_t * in, std::size_t n, int bits, std::uint32_t * out) noexcept;
+
+      RTS_ALWAYS_INLINE RTS_CONST std::size_t packed_words(std::size_t n, int bits) noexcept { return (n * std::size_t(bits) + 63) / 64; }
+      RTS_ALWAYS_INLINE RTS_CONST std::uint32_t zigzag(std::uint32_t d) noexcept { return (d << 1) ^ std::uint32_t(-std::int32_t(d >> 31)); }
+      RTS_ALWAYS_INLINE RTS_CONST std::uint32_t unzigzag(std::uint32_t z) noexcept { return (z >> 1) ^ (0u - (z & 1)); }
+
+      RTS_ALWAYS_INLINE RTS_CONST int bit_width(std::uint32_t v) noexcept {
+        int r = 0;
+        while (v) { ++r; v >>= 1; }
+        return r;
+      }
+
+      // header of each encoded block, followed by its packed words
+      struct block_header {
+        std::int32_t base;
+        std::uint32_t bits;
+      };
+
+      template <class T>
+      void block_stats(const T * values, std::size_t n, T & lo, T & hi) noexcept {
+        lo = hi = values[0];
+        for (std::size_t i=1;i<n;++i) {
+          if (values[i] < lo) lo = values[i];
+          if (hi < values[i]) hi = values[i];
+        }
+      }
+
+      // the elements of a container whose vectors are plain arrays of its values
+      template <class C>
+      RTS_ALWAYS_INLINE const typename C::value_type * values_of(const C & c) noexcept {
+        using T = typename C::value_type;
+        static_assert(sizeof(typename C::vector) == sizeof(T) * C::arch::width, "columnar needs vec<T,A> to be laid out as a plain array of T");
+        return reinterpret_cast<const T *>(&c.vget(0));
+      }
+    }
+
+    /// writes a columnar file one column at a time, streaming each column's blocks straight out of its container
+    class writer {
+    public:
+      explicit writer(const char * path, std::uint32_t block_rows = default_block_rows);
+      writer(const writer &) = delete;
+      writer & operator = (const writer &) = delete;
+      ~writer();
+
+      /// append @p column, an @p soa, @p soa_vector or other container of float or int32 with contiguous vectors.
+      /// every column must have the same length as the first
+      template <class C>
+      void add(const char * name, const C & column, const column_options & options = column_options()) {
+        using T = typename C::value_type;
+        const std::size_t n = column.length();
+        add_values<T>(name, n ? detail::values_of(column) : nullptr, n, std::uint32_t(C::arch::alignment), options);
+      }
+
+      /// append @p n values
+      template <class T>
+      void add_values(const char * name, const T * values, std::size_t n, std::uint32_t alignment, const column_options & options = column_options());
+
+      /// write the directory and header and close the file. called by the destructor if need be, which swallows errors.
+      void close();
+
+      std::uint64_t rows() const noexcept { return rows_; }
+      std::uint32_t block_rows() const noexcept { return block_rows_; }
+
+    private:
+      column_header & begin_column(const char * name, std::size_t n, type t, encoding e, std::uint32_t alignment, bool stats);
+      void write(const void * p, std::size_t bytes);
+      void pad_to(std::size_t alignment);
+
+      std::FILE * file_;
+      std::uint64_t offset_;
+      std::uint64_t rows_;
+      std::uint32_t block_rows_;
+      std::vector<column_header> columns_;
+    };
+
+    template <class T>
+    void writer::add_values(const char * name, const T * values, std::size_t n, std::uint32_t alignment, const column_options & options) {
+      const type t = type_of<T>::value;
+      if (options.encoding != encoding::plain && t != type::int32)
+        throw std::invalid_argument("rts::columnar: only int32 columns can be bit packed");
+      column_header & h = begin_column(name, n, t, options.encoding, alignment, options.stats);
+      const std::size_t blocks = (n + block_rows_ - 1) / block_rows_;
+
+      if (options.encoding == encoding::plain) {
+        write(values, n * sizeof(T));
+        h.bytes = n * sizeof(T);
+        pad_to(64); // so a reader may load whole vectors from the last partial one
+      } else {
+        std::vector<std::uint64_t> index(blocks + 1, 0);
+        std::vector<std::uint32_t> u(block_rows_);
+        std::vector<std::uint64_t> words(detail::packed_words(block_rows_, 32));
+        for (std::size_t b=0;b<blocks;++b) {
+          const T * v = values + b * block_rows_;
+          const std::size_t m = std::min<std::size_t>(block_rows_, n - b * block_rows_);
+          detail::block_header bh;
+          std::uint32_t any = 0;
+          if (options.encoding == encoding::bitpack) {
+            T lo, hi;
+            detail::block_stats(v, m, lo, hi);
+            bh.base = std::int32_t(lo);
+            for (std::size_t i=0;i<m;++i) any |= u[i] = std::uint32_t(v[i]) - std::uint32_t(lo);
+          } else {
+            bh.base = std::int32_t(v[0]);
+            u[0] = 0;
+            for (std::size_t i=1;i<m;++i) any |= u[i] = detail::zigzag(std::uint32_t(v[i]) - std::uint32_t(v[i-1]));
+          }
+          bh.bits = std::uint32_t(detail::bit_width(any));
+          write(&bh, sizeof(bh));
+          write(words.data(), detail::pack(u.data(), m, int(bh.bits), words.data()) * sizeof(std::uint64_t));
+          index[b + 1] = offset_ - h.offset;
+        }
+        h.bytes = offset_ - h.offset;
+        pad_to(8);
+        h.index = offset_;
+        write(index.data(), index.size() * sizeof(std::uint64_t));
+      }
+
+      if (options.stats && blocks) {
+        std::vector<T> stats(2 * blocks);
+        for (std::size_t b=0;b<blocks;++b)
+          detail::block_stats(values + b * block_rows_, std::min<std::size_t>(block_rows_, n - b * block_rows_), stats[2*b], stats[2*b+1]);
+        pad_to(8);
+        h.stats = offset_;
+        write(stats.data(), stats.size() * sizeof(T));
+      }
+    }
+
+    /// a plain column of a @p reader, read in place as an soa expression
+    template <class T, class A = default_isa>
+    struct column_view : rts::detail::soa_expr<column_view<T,A>,dynamic_size,A> {
+      using arch = A;
+      using vector = vec<T,A>;
+      using value_type = T;
+
+      const vector * data;
+      std::size_t n;
+
+      RTS_ALWAYS_INLINE constexpr column_view(const vector * data, std::size_t n) noexcept : data(data), n(n) {}
+
+      RTS_ALWAYS_INLINE RTS_PURE std::size_t size() const noexcept { return n; }
+      RTS_ALWAYS_INLINE RTS_PURE std::size_t length() const noexcept { return n; }
+      RTS_ALWAYS_INLINE RTS_PURE int wsize() const noexcept { return int(n >> A::shift); }
+      RTS_ALWAYS_INLINE RTS_PURE bool needs_last() const noexcept { return (n & A::shift_mask) != 0; }
+      RTS_ALWAYS_INLINE RTS_CONST const vector & vget(int i) const noexcept { return data[i]; }
+      RTS_ALWAYS_INLINE RTS_CONST const vector & vget(int i, const vec<bool,A> &) const noexcept { return data[i]; }
+      RTS_ALWAYS_INLINE void prefetch(int i) const noexcept { _mm_prefetch(reinterpret_cast<const char *>(data + i), _MM_HINT_T0); }
+      RTS_ALWAYS_INLINE RTS_PURE T get(std::size_t i) const noexcept { return reinterpret_cast<const T *>(data)[i]; }
+    };
+
+    /// reads a columnar file, mapping it where the platform allows. plain columns are used in place.
+    class reader {
+    public:
+      explicit reader(const char * path);
+      reader(const reader &) = delete;
+      reader & operator = (const reader &) = delete;
+      ~reader();
+
+      std::uint64_t rows() const noexcept { return header_->rows; }
+      std::size_t columns() const noexcept { return header_->columns; }
+      std::uint32_t block_rows() const noexcept { return header_->block_rows; }
+      std::size_t blocks() const noexcept { return std::size_t(header_->rows / header_->block_rows + (header_->rows % header_->block_rows != 0)); }
+      const column_header & column(std::size_t c) const;
+
+      /// the index of the column named @p name. throws @p std::out_of_range if there is none
+      std::size_t find(const char * name) const;
+
+      /// the (min,max) of block @p b of column @p c, which must have stats
+      template <class T>
+      std::pair<T,T> stats(std::size_t c, std::size_t b) const {
+        const column_header & h = checked<T>(c);
+        if (!h.has_stats || b >= blocks()) throw std::out_of_range("rts::columnar: no stats for that block");
+        const T * s = reinterpret_cast<const T *>(base_ + h.stats);
+        return std::make_pair(s[2*b], s[2*b+1]);
+      }
+
+      /// the values of a plain column, in place, or nullptr if the column is encoded
+      template <class T>
+      const T * values(std::size_t c) const {
+        const column_header & h = checked<T>(c);
+        return h.encoding == std::uint8_t(encoding::plain) ? reinterpret_cast<const T *>(base_ + h.offset) : nullptr;
+      }
+
+      /// a plain column as an soa expression, without copying. throws @p std::invalid_argument if the column is encoded
+      template <class T, class A = default_isa>
+      column_view<T,A> view(std::size_t c) const {
+        const T * p = values<T>(c);
+        if (p == nullptr) throw std::invalid_argument("rts::columnar: only plain columns can be viewed in place");
+        if (column(c).alignment < std::uint32_t(A::alignment)) throw std::invalid_argument("rts::columnar: column is not aligned for this arch");
+        return column_view<T,A>(reinterpret_cast<const vec<T,A> *>(p), std::size_t(rows()));
+      }
+
+      /// decode block @p b of column @p c into @p out, which has room for @p block_rows() values
+      template <class T>
+      void read_block(std::size_t c, std::size_t b, T * out) const {
+        const column_header & h = checked<T>(c);
+        if (b >= blocks()) throw std::out_of_range("rts::columnar: block out of range");
+        const std::size_t first = b * block_rows();
+        const std::size_t m = std::min<std::size_t>(block_rows(), std::size_t(rows()) - first);
+        if (h.encoding == std::uint8_t(encoding::plain)) {
+          std::memcpy(out, base_ + h.offset + first * sizeof(T), m * sizeof(T));
+          return;
+        }
+        const std::uint64_t * index = reinterpret_cast<const std::uint64_t *>(base_ + h.index);
+        const unsigned char * p = base_ + h.offset + index[b];
+        detail::block_header bh;
+        std::memcpy(&bh, p, sizeof(bh));
+        std::uint32_t * u = reinterpret_cast<std::uint32_t *>(out); // int32 only
+        detail::unpack(reinterpret_cast<const std::uint64_t *>(p + sizeof(bh)), m, int(bh.bits), u);
+        if (h.encoding == std::uint8_t(encoding::bitpack)) {
+          for (std::size_t i=0;i<m;++i) u[i] += std::uint32_t(bh.base);
+        } else {
+          std::uint32_t acc = std::uint32_t(bh.base);
+          for (std::size_t i=0;i<m;++i) u[i] = acc += detail::unzigzag(u[i]);
+        }
+      }
+
+      /// decode all of column @p c into @p out, one block at a time
+      template <class T, class A>
+      void read(std::size_t c, soa_vector<T,A> & out) const {
+        checked<T>(c);
+        out.resize(std::size_t(rows()));
+        if (out.empty()) return;
+        T * p = const_cast<T *>(detail::values_of(out));
+        for (std::size_t b=0, e=blocks();b<e;++b)
+          read_block(c, b, p + b * block_rows());
+      }
+
+    private:
+      template <class T>
+      const column_header & checked(std::size_t c) const {
+        const column_header & h = column(c);
+        if (h.type != std::uint8_t(type_of<T>::value)) throw std::invalid_argument("rts::columnar: column type mismatch");
+        return h;
+      }
+
+      void validate(std::size_t file_bytes);
+      void release() noexcept;
+
+      const unsigned char * base_;
+      std::size_t bytes_;
+      bool mapped_;
+      const file_header * header_;
+      const column_header * columns_;
+    };
+  }
+}
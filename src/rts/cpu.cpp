@@ -118,6 +118,56 @@ namespace rts {
     }
 #endif
   }
+
+#ifndef __arm__
+  // walk the deterministic cache parameters of cpuid leaf 4 (intel) or 0x8000001d (amd)
+  static void read_caches(int leaf, cache_sizes & result) noexcept {
+    for (int i=0;i<16;++i) {
+      int info[4];
+      __cpuidex(info,leaf,i);
+      int type = info[0] & 0x1f;
+      if (type == 0) break;     // no more caches
+      if (type == 2) continue;  // instruction cache
+      int level = (info[0] >> 5) & 0x7;
+      std::size_t line = std::size_t(info[1] & 0xfff) + 1;
+      std::size_t size = (std::size_t((unsigned(info[1]) >> 22) & 0x3ff) + 1) // ways
+                       * (std::size_t((info[1] >> 12) & 0x3ff) + 1)          // partitions
+                       * line
+                       * (std::size_t(unsigned(info[2])) + 1);                // sets
+      switch (level) {
+        case 1: result.l1d = size; result.line = line; break;
+        case 2: result.l2 = size; break;
+        case 3: result.l3 = size; break;
+        default: break;
+      }
+    }
+  }
+#endif
+
+  static cache_sizes detect_caches() noexcept {
+    cache_sizes result = { 0, 0, 0, 0 };
+#ifndef __arm__
+    int info[4];
+    __cpuid(info,0);
+    int max_leaf = info[0];
+    bool amd = info[1] == 0x68747541; // "Auth"enticAMD
+    __cpuid(info,int(0x80000000));
+    unsigned max_extended_leaf = unsigned(info[0]);
+    if (amd && max_extended_leaf >= 0x8000001d)
+      read_caches(int(0x8000001d), result);
+    else if (!amd && max_leaf >= 4)
+      read_caches(4, result);
+#endif
+    if (result.line == 0) result.line = 64;
+    if (result.l1d == 0) result.l1d = 32 * 1024;
+    if (result.l2 == 0) result.l2 = 256 * 1024;
+    return result;
+  }
+
+  const cache_sizes & system_caches() noexcept {
+    static const cache_sizes caches = detect_caches();
+    return caches;
+  }
 } // namespace
 
 /*
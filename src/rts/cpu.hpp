@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+
 #if defined(__LP64__) || defined(_WIN64) || (defined(__x86_64__) && !defined(__ILP32__) ) || defined(_M_X64) || defined(__ia64) || defined (_M_IA64) || defined(__aarch64__) || defined(__powerpc64__)
 #define RTS_64 1
 #else
@@ -23,4 +25,16 @@ namespace rts {
     max_isa = amd_neon
   };
   extern isa system_isa() noexcept;
+
+  /// data cache sizes, in bytes
+  struct cache_sizes {
+    std::size_t line; ///< cache line
+    std::size_t l1d;  ///< level 1 data cache
+    std::size_t l2;   ///< level 2 cache
+    std::size_t l3;   ///< level 3 cache, 0 if there is none
+  };
+
+  /// the data caches of the current processor, detected on first use.
+  /// anything that can't be detected reads as a 64 byte line, 32KiB l1d, 256KiB l2 and no l3.
+  extern const cache_sizes & system_caches() noexcept;
 }
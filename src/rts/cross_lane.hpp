@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include "varying.hpp"
+
+/// @file rts/cross_lane.hpp
+/// @brief SPMD operations that read other program instances' lanes
+///
+/// Every operation here is built on one lane permutation, @p detail::permute, which is a single @p vpermps/@p vpermd
+/// on AVX2, a pair of in-lane @p vpermilps on AVX and a @p vpermilps at 128 bits. Reductions and scans honor the
+/// execution mask: inactive lanes contribute nothing to them.
+
+namespace rts {
+  namespace detail {
+    // lane i of the result is lane idx[i] mod A::width of v
+    template <class T, class A>
+    RTS_ALWAYS_INLINE RTS_PURE vec<T,A> permute(const vec<T,A> & v, const vec<std::int32_t,A> & idx) noexcept {
+      vec<T,A> result;
+      for (int i=0;i<A::width;++i) result.put(i, v.get(idx.get(i) & A::shift_mask));
+      return result;
+    }
+
+  #ifdef __AVX__
+    RTS_ALWAYS_INLINE RTS_PURE vec<float,target::avx_4> permute(const vec<float,target::avx_4> & v, const vec<std::int32_t,target::avx_4> & idx) noexcept {
+      return vec<float,target::avx_4>(_mm_permutevar_ps(v.m, idx.m), internal_tag);
+    }
+
+    RTS_ALWAYS_INLINE RTS_PURE vec<std::int32_t,target::avx_4> permute(const vec<std::int32_t,target::avx_4> & v, const vec<std::int32_t,target::avx_4> & idx) noexcept {
+      return vec<std::int32_t,target::avx_4>(_mm_castps_si128(_mm_permutevar_ps(_mm_castsi128_ps(v.m), idx.m)), internal_tag);
+    }
+
+    // vpermilps only moves lanes within each 128 bit half, so permute both halves of v into both and pick by bit 2
+    RTS_ALWAYS_INLINE RTS_PURE __m256 permute_avx_8(__m256 v, const vec<std::int32_t,target::avx_8> & idx) noexcept {
+      const __m256 from_lo = _mm256_permutevar_ps(_mm256_permute2f128_ps(v, v, 0x00), idx.m);
+      const __m256 from_hi = _mm256_permutevar_ps(_mm256_permute2f128_ps(v, v, 0x11), idx.m);
+      const __m256 hi = _mm256_castsi256_ps(_mm256_setr_m128i(_mm_slli_epi32(idx.n[0], 29), _mm_slli_epi32(idx.n[1], 29)));
+      return _mm256_blendv_ps(from_lo, from_hi, hi);
+    }
+
+    RTS_ALWAYS_INLINE RTS_PURE vec<float,target::avx_8> permute(const vec<float,target::avx_8> & v, const vec<std::int32_t,target::avx_8> & idx) noexcept {
+      return vec<float,target::avx_8>(permute_avx_8(v.m, idx), internal_tag);
+    }
+
+    RTS_ALWAYS_INLINE RTS_PURE vec<std::int32_t,target::avx_8> permute(const vec<std::int32_t,target::avx_8> & v, const vec<std::int32_t,target::avx_8> & idx) noexcept {
+      return vec<std::int32_t,target::avx_8>(_mm256_castps_si256(permute_avx_8(_mm256_castsi256_ps(v.m), idx)), internal_tag);
+    }
+  #endif
+
+  #ifdef __AVX2__
+    RTS_ALWAYS_INLINE RTS_PURE vec<float,target::avx2_8> permute(const vec<float,target::avx2_8> & v, const vec<std::int32_t,target::avx2_8> & idx) noexcept {
+      return vec<float,target::avx2_8>(_mm256_permutevar8x32_ps(v.m, idx.m), internal_tag);
+    }
+
+    RTS_ALWAYS_INLINE RTS_PURE vec<std::int32_t,target::avx2_8> permute(const vec<std::int32_t,target::avx2_8> & v, const vec<std::int32_t,target::avx2_8> & idx) noexcept {
+      return vec<std::int32_t,target::avx2_8>(_mm256_permutevar8x32_epi32(v.m, idx.m), internal_tag);
+    }
+  #endif
+
+    // lane i of the result is lane i - k of v, or zero below k
+    template <class T, class A>
+    RTS_ALWAYS_INLINE RTS_PURE vec<T,A> shift_up(const vec<T,A> & v, int k) noexcept {
+      using ivec = vec<std::int32_t,A>;
+      const ivec lanes = lane_indices<A>();
+      return blend(lanes >= ivec(k), permute(v, lanes - ivec(k)), vec<T,A>(T()));
+    }
+
+    template <class T, class A>
+    RTS_ALWAYS_INLINE RTS_PURE T horizontal_add(vec<T,A> v) noexcept {
+      using ivec = vec<std::int32_t,A>;
+      const ivec lanes = lane_indices<A>();
+      for (int k=A::width/2;k>0;k/=2) v = v + permute(v, lanes + ivec(k));
+      return v.get(0);
+    }
+
+    template <class T, class A>
+    RTS_ALWAYS_INLINE RTS_PURE vec<T,A> exclusive_prefix_add(vec<T,A> v) noexcept {
+      for (int k=1;k<A::width;k*=2) v = v + shift_up(v, k);
+      return shift_up(v, 1);
+    }
+  }
+
+  /// the index of each program instance: lane i holds i
+  template <class A = default_isa>
+  RTS_ALWAYS_INLINE RTS_PURE varying<std::int32_t,A> program_index() noexcept {
+    return varying<std::int32_t,A>(detail::lane_indices<A>());
+  }
+
+  /// the number of program instances running together
+  template <class A = default_isa>
+  RTS_ALWAYS_INLINE RTS_CONST constexpr int program_count() noexcept {
+    return A::width;
+  }
+
+  /// lane @p lane of @p v in every lane
+  template <class T, class A>
+  RTS_ALWAYS_INLINE RTS_PURE varying<T,A> broadcast(const varying<T,A> & v, int lane) noexcept {
+    return varying<T,A>(detail::permute(v.data, vec<std::int32_t,A>(lane)));
+  }
+
+  /// lane i of the result is lane (i + k) mod @p program_count() of @p v
+  template <class T, class A>
+  RTS_ALWAYS_INLINE RTS_PURE varying<T,A> rotate(const varying<T,A> & v, int k) noexcept {
+    return varying<T,A>(detail::permute(v.data, detail::lane_indices<A>() + vec<std::int32_t,A>(k)));
+  }
+
+  /// lane i of the result is lane @p idx[i] mod @p program_count() of @p v
+  template <class T, class A>
+  RTS_ALWAYS_INLINE RTS_PURE varying<T,A> shuffle(const varying<T,A> & v, const varying<std::int32_t,A> & idx) noexcept {
+    return varying<T,A>(detail::permute(v.data, idx.data));
+  }
+
+  /// the sum of the lanes of @p v set in @p mask
+  template <class T, class A>
+  RTS_ALWAYS_INLINE RTS_PURE T reduce_add(const varying<T,A> & v, const vec<bool,A> & mask) noexcept {
+    return detail::horizontal_add(detail::blend(mask, v.data, vec<T,A>(T())));
+  }
+
+  /// the sum of the active lanes of @p v
+  template <class T, class A>
+  RTS_ALWAYS_INLINE T reduce_add(const varying<T,A> & v) noexcept {
+    return reduce_add(v, execution_mask<A>);
+  }
+
+  /// lane i of the result is the sum of the lanes of @p v below i that are set in @p mask
+  template <class T, class A>
+  RTS_ALWAYS_INLINE RTS_PURE varying<T,A> exclusive_scan_add(const varying<T,A> & v, const vec<bool,A> & mask) noexcept {
+    return varying<T,A>(detail::exclusive_prefix_add(detail::blend(mask, v.data, vec<T,A>(T()))));
+  }
+
+  /// lane i of the result is the sum of the active lanes of @p v below i
+  template <class T, class A>
+  RTS_ALWAYS_INLINE varying<T,A> exclusive_scan_add(const varying<T,A> & v) noexcept {
+    return exclusive_scan_add(v, execution_mask<A>);
+  }
+}
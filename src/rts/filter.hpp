@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include "soa.hpp"
+#include "soa_vector.hpp"
+#include "x86.hpp"
+
+/// @file rts/filter.hpp
+/// @brief compacting soa expressions by a predicate
+///
+/// Each vector of the predicate becomes a bit mask via @p movemask, and the selected lanes of the source vector are
+/// packed to the front and stored whole, advancing the output by the popcount of the mask. Nothing branches on the data.
+
+namespace rts {
+  namespace detail {
+    // store the lanes of v whose bits are set in m contiguously at out, returning how many. writes out[0,A::width).
+    template <class T, class A>
+    RTS_ALWAYS_INLINE int compress_store(T * out, const vec<T,A> & v, std::uint32_t m) noexcept {
+      int o = 0;
+      while (m) out[o++] = v.get(bscf(m));
+      return o;
+    }
+
+  #ifdef __AVX2__
+    // for each 8 bit mask, the indices of its set bits packed a nibble apiece from the bottom
+    struct compress_table {
+      std::uint32_t d[256];
+      constexpr compress_table() noexcept : d() {
+        for (int m=0;m<256;++m) {
+          std::uint32_t v = 0;
+          int k = 0;
+          for (int i=0;i<8;++i)
+            if (m & (1 << i)) v |= std::uint32_t(i) << (4 * k++);
+          d[m] = v;
+        }
+      }
+    };
+
+    static constexpr compress_table compress_lanes {};
+
+    RTS_ALWAYS_INLINE RTS_PURE __m256i compress_permutation(std::uint32_t m) noexcept {
+      const __m256i nibbles = _mm256_set1_epi32(int(compress_lanes.d[m]));
+      return _mm256_and_si256(_mm256_srlv_epi32(nibbles, _mm256_setr_epi32(0,4,8,12,16,20,24,28)), _mm256_set1_epi32(15));
+    }
+
+    RTS_ALWAYS_INLINE int compress_store(float * out, const vec<float,target::avx2_8> & v, std::uint32_t m) noexcept {
+      _mm256_storeu_ps(out, _mm256_permutevar8x32_ps(v.m, compress_permutation(m)));
+      return popcnt(m);
+    }
+
+    RTS_ALWAYS_INLINE int compress_store(std::int32_t * out, const vec<std::int32_t,target::avx2_8> & v, std::uint32_t m) noexcept {
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), _mm256_permutevar8x32_epi32(v.m, compress_permutation(m)));
+      return popcnt(m);
+    }
+  #endif
+
+    // compress the elements of src where pred is set into out, and if rest is not null, the others into rest.
+    // each output needs room for pred.length() rounded up to whole vectors. returns the number kept.
+    template <class T, class S, class P, std::size_t N, class A>
+    std::size_t filter_eval(T * out, T * rest, const soa_expr<S,N,A> & src, const soa_expr<P,N,A> & pred) noexcept {
+      const std::size_t n = pred.length();
+      const int w = int(n >> A::shift);
+      std::size_t o = 0, r = 0;
+      int i = 0;
+      for (;i < w;++i) {
+        const auto v = src.vget(i);
+        const std::uint32_t m = movemask(pred.vget(i));
+        o += std::size_t(compress_store(out + o, v, m));
+        if (rest != nullptr) r += std::size_t(compress_store(rest + r, v, m ^ std::uint32_t(A::width_mask)));
+      }
+      if (const int tail = int(n & A::shift_mask)) {
+        const vec<bool,A> lanes = first_lanes<A>(tail);
+        const auto v = src.vget(i, lanes);
+        const std::uint32_t m = movemask(pred.vget(i, lanes));
+        o += std::size_t(compress_store(out + o, v, m & movemask(lanes)));
+        if (rest != nullptr) compress_store(rest + r, v, ~m & movemask(lanes));
+      }
+      return o;
+    }
+
+    // the index of each element, as an expression
+    template <std::size_t N, class A>
+    struct soa_iota : soa_expr<soa_iota<N,A>,N,A> {
+      using vector = vec<std::int32_t,A>;
+      static const int leaves = 0;
+      vector lanes;
+      std::size_t n;
+      RTS_ALWAYS_INLINE explicit soa_iota(std::size_t n) noexcept : lanes(lane_indices<A>()), n(n) {}
+      RTS_ALWAYS_INLINE RTS_PURE vector vget(int i) const noexcept { return lanes + vector(i << A::shift); }
+      RTS_ALWAYS_INLINE RTS_PURE vector vget(int i, const vec<bool,A> &) const noexcept { return vget(i); }
+      RTS_ALWAYS_INLINE void prefetch(int) const noexcept {}
+      RTS_ALWAYS_INLINE RTS_PURE std::size_t length() const noexcept { return n; }
+    };
+
+    template <class T, class A>
+    RTS_ALWAYS_INLINE T * filter_data(soa_vector<T,A> & dst) noexcept {
+      static_assert(sizeof(vec<T,A>) == sizeof(T) * A::width, "filter needs vec<T,A> to be laid out as a plain array of T");
+      return reinterpret_cast<T *>(dst.vdata());
+    }
+  }
+
+  /// copy the elements of @p src where the boolean expression @p pred is set to @p dst, in order, e.g. @p filter(y, x, x > t).
+  /// returns the number kept, which is also the new size of @p dst. @p dst must not be read by @p src or @p pred.
+  template <class T, class S, class P, std::size_t N, class A>
+  std::size_t filter(soa_vector<T,A> & dst, const detail::soa_expr<S,N,A> & src, const detail::soa_expr<P,N,A> & pred) {
+    dst.resize(pred.length());
+    const std::size_t k = detail::filter_eval(detail::filter_data(dst), static_cast<T *>(nullptr), src, pred);
+    dst.resize(k);
+    return k;
+  }
+
+  /// the indices of the set elements of @p pred, in ascending order: a selection vector for @p view or further filtering.
+  /// returns their number, which is also the new size of @p dst.
+  template <class P, std::size_t N, class A>
+  std::size_t select(soa_vector<std::int32_t,A> & dst, const detail::soa_expr<P,N,A> & pred) {
+    return filter(dst, detail::soa_iota<N,A>(pred.length()), pred);
+  }
+
+  /// copy @p src to @p dst with the elements where @p pred is set first and the rest after, each group in its original order.
+  /// returns the size of the first group. @p dst must not be read by @p src or @p pred.
+  template <class T, class S, class P, std::size_t N, class A>
+  std::size_t partition(soa_vector<T,A> & dst, const detail::soa_expr<S,N,A> & src, const detail::soa_expr<P,N,A> & pred) {
+    const std::size_t n = pred.length();
+    soa_vector<T,A> rest(n);
+    dst.resize(n);
+    T * out = detail::filter_data(dst);
+    const std::size_t k = detail::filter_eval(out, detail::filter_data(rest), src, pred);
+    std::copy(detail::filter_data(rest), detail::filter_data(rest) + (n - k), out + k);
+    return k;
+  }
+}
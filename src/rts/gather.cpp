@@ -0,0 +1,87 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "gather.hpp"
+#include "vec.hpp"
+
+namespace rts {
+  namespace detail {
+    // constant initialized, so it is usable by gathers that run before the tuner below
+    gather_strategy active_gather_strategy = gather_strategy::hardware;
+
+#ifdef __AVX2__
+    // time gathers of int32_t through a vec<int32_t*,avx2_8>, half scattered across a table
+    // that fits in l2 and half clustered in 64 byte windows, which is where permute pays off.
+    static double time_gathers(gather_strategy s) noexcept {
+      using A = target::avx2_8;
+      static const int table_size = 1 << 14;
+      static const int batches = 256;
+      alignas(32) static std::int32_t table[table_size];
+      static vec<std::int32_t*,A> pointers[2*batches];
+      static bool initialized = false;
+      if (!initialized) {
+        initialized = true;
+        std::uint32_t x = 0x9e3779b9u; // xorshift, deterministic across runs
+        auto next = [&]() { x ^= x << 13; x ^= x >> 17; x ^= x << 5; return x; };
+        for (int i=0;i<table_size;++i) table[i] = i;
+        for (int b=0;b<batches;++b) {
+          int window = static_cast<int>(next() % (table_size/16)) * 16;
+          for (int i=0;i<A::width;++i) {
+            pointers[2*b].put(i, table + next() % table_size);
+            pointers[2*b+1].put(i, table + window + next() % 16);
+          }
+        }
+      }
+      gather_strategy saved = active_gather_strategy;
+      active_gather_strategy = s;
+      double best = 1e300;
+      for (int trial=0;trial<5;++trial) {
+        vec<std::int32_t,A> acc(0);
+        auto start = std::chrono::steady_clock::now();
+        for (int rep=0;rep<8;++rep)
+          for (auto && p : pointers)
+            acc += load(p);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        volatile std::int32_t sink = acc.get(0); // keep the loop alive
+        (void)sink;
+        if (elapsed.count() < best) best = elapsed.count();
+      }
+      active_gather_strategy = saved;
+      return best;
+    }
+#endif
+
+    static gather_strategy parse_gather_strategy(const char * s) noexcept {
+      if (s == nullptr) return gather_strategy::automatic;
+      if (std::strcmp(s,"hardware") == 0) return gather_strategy::hardware;
+      if (std::strcmp(s,"scalar") == 0) return gather_strategy::scalar;
+      if (std::strcmp(s,"permute") == 0) return gather_strategy::permute;
+      return gather_strategy::automatic;
+    }
+
+    static RTS_UNUSED const bool gather_strategy_initialized = (pin_gather_strategy(parse_gather_strategy(std::getenv("RTS_GATHER"))), true);
+  }
+
+  gather_strategy tune_gather_strategy() noexcept {
+#ifdef __AVX2__
+    gather_strategy best = gather_strategy::hardware;
+    double best_time = detail::time_gathers(best);
+    for (gather_strategy s : { gather_strategy::scalar, gather_strategy::permute }) {
+      double t = detail::time_gathers(s);
+      if (t < best_time) { best = s; best_time = t; }
+    }
+    return best;
+#else
+    return gather_strategy::scalar; // the only loaders we have are scalar
+#endif
+  }
+
+  gather_strategy current_gather_strategy() noexcept {
+    return detail::active_gather_strategy;
+  }
+
+  void pin_gather_strategy(gather_strategy s) noexcept {
+    detail::active_gather_strategy = s == gather_strategy::automatic ? tune_gather_strategy() : s;
+  }
+}
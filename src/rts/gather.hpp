@@ -0,0 +1,33 @@
+#pragma once
+
+/// @file rts/gather.hpp
+/// @brief selection of the strategy used to gather through a @p vec<T*,A>
+
+namespace rts {
+  /// how a @p vec<T*,A> is dereferenced into a @p vec<T,A>
+  enum class gather_strategy : int {
+    automatic = 0, ///< benchmark the alternatives on this cpu and keep the fastest
+    hardware = 1,  ///< @p vpgatherdd / @p vpgatherqd
+    scalar = 2,    ///< one scalar load per lane, inserted into the vector
+    permute = 3    ///< two aligned loads and a permute when the lanes are clustered, hardware otherwise
+  };
+
+  /// @cond PRIVATE
+  namespace detail {
+    // read by the loaders on every gather. never automatic once static initialization has run.
+    extern gather_strategy active_gather_strategy;
+  }
+  /// @endcond
+
+  /// the strategy currently used by the loaders
+  extern gather_strategy current_gather_strategy() noexcept;
+
+  /// pin the strategy used by the loaders. @p gather_strategy::automatic re-runs the benchmark.
+  ///
+  /// The environment variable @p RTS_GATHER (@p hardware, @p scalar, @p permute or @p auto) does the same at startup.
+  /// This is not synchronized with concurrent gathers, so pin before spawning threads that gather.
+  extern void pin_gather_strategy(gather_strategy s) noexcept;
+
+  /// run the gather micro-benchmark and return the fastest strategy without installing it
+  extern gather_strategy tune_gather_strategy() noexcept;
+}
@@ -0,0 +1,413 @@
+#pragma once
+
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "vec.hpp"
+
+/// @file rts/interleave.hpp
+/// @brief transposition between arrays of structures and @p vec lanes, in the spirit of ARM @p vld3 / @p vst3
+
+namespace rts {
+  namespace detail {
+    // K interleaved 32 bit fields of 8 lanes, as 8 wide registers. the primary template goes through a scratch buffer.
+    template <int K>
+    struct interleave_ps256 {
+#ifdef __AVX__
+      static RTS_ALWAYS_INLINE void load(const float * p, __m256 (&r)[K]) noexcept {
+        alignas(32) float t[K][8];
+        for (int i=0;i<8;++i)
+          for (int k=0;k<K;++k) t[k][i] = p[i*K+k];
+        for (int k=0;k<K;++k) r[k] = _mm256_load_ps(t[k]);
+      }
+      static RTS_ALWAYS_INLINE void store(float * p, const __m256 (&r)[K]) noexcept {
+        alignas(32) float t[K][8];
+        for (int k=0;k<K;++k) _mm256_store_ps(t[k], r[k]);
+        for (int i=0;i<8;++i)
+          for (int k=0;k<K;++k) p[i*K+k] = t[k][i];
+      }
+#endif
+    };
+
+    // the same for 4 lanes in 4 wide registers
+    template <int K>
+    struct interleave_ps128 {
+#ifdef __AVX__
+      static RTS_ALWAYS_INLINE void load(const float * p, __m128 (&r)[K]) noexcept {
+        alignas(16) float t[K][4];
+        for (int i=0;i<4;++i)
+          for (int k=0;k<K;++k) t[k][i] = p[i*K+k];
+        for (int k=0;k<K;++k) r[k] = _mm_load_ps(t[k]);
+      }
+      static RTS_ALWAYS_INLINE void store(float * p, const __m128 (&r)[K]) noexcept {
+        alignas(16) float t[K][4];
+        for (int k=0;k<K;++k) _mm_store_ps(t[k], r[k]);
+        for (int i=0;i<4;++i)
+          for (int k=0;k<K;++k) p[i*K+k] = t[k][i];
+      }
+#endif
+    };
+
+#ifdef __AVX__
+    // 4x4 transpose within each 128 bit half. it is its own inverse.
+    static RTS_ALWAYS_INLINE void transpose4_ps(__m256 & a, __m256 & b, __m256 & c, __m256 & d) noexcept {
+      __m256 u0 = _mm256_unpacklo_ps(a,b), u1 = _mm256_unpackhi_ps(a,b);
+      __m256 u2 = _mm256_unpacklo_ps(c,d), u3 = _mm256_unpackhi_ps(c,d);
+      a = _mm256_shuffle_ps(u0,u2,0x44); b = _mm256_shuffle_ps(u0,u2,0xee);
+      c = _mm256_shuffle_ps(u1,u3,0x44); d = _mm256_shuffle_ps(u1,u3,0xee);
+    }
+
+    static RTS_ALWAYS_INLINE void transpose4_ps(__m128 & a, __m128 & b, __m128 & c, __m128 & d) noexcept {
+      __m128 u0 = _mm_unpacklo_ps(a,b), u1 = _mm_unpackhi_ps(a,b);
+      __m128 u2 = _mm_unpacklo_ps(c,d), u3 = _mm_unpackhi_ps(c,d);
+      a = _mm_shuffle_ps(u0,u2,0x44); b = _mm_shuffle_ps(u0,u2,0xee);
+      c = _mm_shuffle_ps(u1,u3,0x44); d = _mm_shuffle_ps(u1,u3,0xee);
+    }
+
+    // {x0 y0 z0 x1} {y1 z1 x2 y2} {z2 x3 y3 z3} <-> {x0..x3} {y0..y3} {z0..z3}, within each 128 bit half
+    #define RTS_DEINTERLEAVE3(reg,sfx) \
+      static RTS_ALWAYS_INLINE void deinterleave3_ps(reg & a, reg & b, reg & c) noexcept { \
+        reg xy = _mm##sfx##_shuffle_ps(b,c,_MM_SHUFFLE(2,1,3,2)); \
+        reg yz = _mm##sfx##_shuffle_ps(a,b,_MM_SHUFFLE(1,0,2,1)); \
+        reg x = _mm##sfx##_shuffle_ps(a,xy,_MM_SHUFFLE(2,0,3,0)); \
+        reg y = _mm##sfx##_shuffle_ps(yz,xy,_MM_SHUFFLE(3,1,2,0)); \
+        reg z = _mm##sfx##_shuffle_ps(yz,c,_MM_SHUFFLE(3,0,3,1)); \
+        a = x; b = y; c = z; \
+      } \
+      static RTS_ALWAYS_INLINE void interleave3_ps(reg & x, reg & y, reg & z) noexcept { \
+        reg lo = _mm##sfx##_unpacklo_ps(x,y); \
+        reg hi = _mm##sfx##_unpackhi_ps(x,y); \
+        reg zx = _mm##sfx##_shuffle_ps(z,x,_MM_SHUFFLE(1,1,0,0)); \
+        reg yz = _mm##sfx##_shuffle_ps(y,z,_MM_SHUFFLE(2,1,2,1)); \
+        reg zz = _mm##sfx##_shuffle_ps(z,hi,_MM_SHUFFLE(3,2,3,2)); \
+        x = _mm##sfx##_shuffle_ps(lo,zx,_MM_SHUFFLE(2,0,1,0)); \
+        y = _mm##sfx##_shuffle_ps(yz,hi,_MM_SHUFFLE(1,0,2,0)); \
+        z = _mm##sfx##_shuffle_ps(zz,zz,_MM_SHUFFLE(1,3,2,0)); \
+      }
+
+    RTS_DEINTERLEAVE3(__m128,)
+    RTS_DEINTERLEAVE3(__m256,256)
+
+    #undef RTS_DEINTERLEAVE3
+
+    template <>
+    struct interleave_ps256<2> {
+      static RTS_ALWAYS_INLINE void load(const float * p, __m256 (&r)[2]) noexcept {
+        __m256 a = _mm256_loadu_ps(p), b = _mm256_loadu_ps(p+8);
+        __m256 lo = _mm256_permute2f128_ps(a,b,0x20), hi = _mm256_permute2f128_ps(a,b,0x31);
+        r[0] = _mm256_shuffle_ps(lo,hi,_MM_SHUFFLE(2,0,2,0));
+        r[1] = _mm256_shuffle_ps(lo,hi,_MM_SHUFFLE(3,1,3,1));
+      }
+      static RTS_ALWAYS_INLINE void store(float * p, const __m256 (&r)[2]) noexcept {
+        __m256 lo = _mm256_unpacklo_ps(r[0],r[1]), hi = _mm256_unpackhi_ps(r[0],r[1]);
+        _mm256_storeu_ps(p, _mm256_permute2f128_ps(lo,hi,0x20));
+        _mm256_storeu_ps(p+8, _mm256_permute2f128_ps(lo,hi,0x31));
+      }
+    };
+
+    template <>
+    struct interleave_ps256<3> {
+      static RTS_ALWAYS_INLINE void load(const float * p, __m256 (&r)[3]) noexcept {
+        __m256 r0 = _mm256_loadu_ps(p), r1 = _mm256_loadu_ps(p+8), r2 = _mm256_loadu_ps(p+16);
+        // lanes 0-3 in the low halves, lanes 4-7 in the high halves
+        __m256 a = _mm256_permute2f128_ps(r0,r1,0x30);
+        __m256 b = _mm256_permute2f128_ps(r0,r2,0x21);
+        __m256 c = _mm256_permute2f128_ps(r1,r2,0x30);
+        deinterleave3_ps(a,b,c);
+        r[0] = a; r[1] = b; r[2] = c;
+      }
+      static RTS_ALWAYS_INLINE void store(float * p, const __m256 (&r)[3]) noexcept {
+        __m256 a = r[0], b = r[1], c = r[2];
+        interleave3_ps(a,b,c);
+        _mm256_storeu_ps(p, _mm256_permute2f128_ps(a,b,0x20));
+        _mm256_storeu_ps(p+8, _mm256_permute2f128_ps(c,a,0x30));
+        _mm256_storeu_ps(p+16, _mm256_permute2f128_ps(b,c,0x31));
+      }
+    };
+
+    template <>
+    struct interleave_ps256<4> {
+      static RTS_ALWAYS_INLINE void load(const float * p, __m256 (&r)[4]) noexcept {
+        __m256 r0 = _mm256_loadu_ps(p), r1 = _mm256_loadu_ps(p+8), r2 = _mm256_loadu_ps(p+16), r3 = _mm256_loadu_ps(p+24);
+        r[0] = _mm256_permute2f128_ps(r0,r2,0x20); // lanes 0 and 4
+        r[1] = _mm256_permute2f128_ps(r0,r2,0x31); // lanes 1 and 5
+        r[2] = _mm256_permute2f128_ps(r1,r3,0x20); // lanes 2 and 6
+        r[3] = _mm256_permute2f128_ps(r1,r3,0x31); // lanes 3 and 7
+        transpose4_ps(r[0],r[1],r[2],r[3]);
+      }
+      static RTS_ALWAYS_INLINE void store(float * p, const __m256 (&r)[4]) noexcept {
+        __m256 t0 = r[0], t1 = r[1], t2 = r[2], t3 = r[3];
+        transpose4_ps(t0,t1,t2,t3);
+        _mm256_storeu_ps(p, _mm256_permute2f128_ps(t0,t1,0x20));
+        _mm256_storeu_ps(p+8, _mm256_permute2f128_ps(t2,t3,0x20));
+        _mm256_storeu_ps(p+16, _mm256_permute2f128_ps(t0,t1,0x31));
+        _mm256_storeu_ps(p+24, _mm256_permute2f128_ps(t2,t3,0x31));
+      }
+    };
+
+    template <>
+    struct interleave_ps256<8> {
+      // full 8x8 transpose, its own inverse
+      static RTS_ALWAYS_INLINE void transpose(__m256 (&r)[8]) noexcept {
+        __m256 t[8];
+        for (int i=0;i<4;++i) {
+          t[2*i] = _mm256_unpacklo_ps(r[2*i],r[2*i+1]);
+          t[2*i+1] = _mm256_unpackhi_ps(r[2*i],r[2*i+1]);
+        }
+        __m256 s[8];
+        for (int i=0;i<2;++i) {
+          s[4*i] = _mm256_shuffle_ps(t[4*i],t[4*i+2],0x44);
+          s[4*i+1] = _mm256_shuffle_ps(t[4*i],t[4*i+2],0xee);
+          s[4*i+2] = _mm256_shuffle_ps(t[4*i+1],t[4*i+3],0x44);
+          s[4*i+3] = _mm256_shuffle_ps(t[4*i+1],t[4*i+3],0xee);
+        }
+        for (int i=0;i<4;++i) {
+          r[i] = _mm256_permute2f128_ps(s[i],s[i+4],0x20);
+          r[i+4] = _mm256_permute2f128_ps(s[i],s[i+4],0x31);
+        }
+      }
+      static RTS_ALWAYS_INLINE void load(const float * p, __m256 (&r)[8]) noexcept {
+        for (int i=0;i<8;++i) r[i] = _mm256_loadu_ps(p+8*i);
+        transpose(r);
+      }
+      static RTS_ALWAYS_INLINE void store(float * p, const __m256 (&r)[8]) noexcept {
+        __m256 t[8];
+        for (int i=0;i<8;++i) t[i] = r[i];
+        transpose(t);
+        for (int i=0;i<8;++i) _mm256_storeu_ps(p+8*i, t[i]);
+      }
+    };
+
+    template <>
+    struct interleave_ps128<2> {
+      static RTS_ALWAYS_INLINE void load(const float * p, __m128 (&r)[2]) noexcept {
+        __m128 a = _mm_loadu_ps(p), b = _mm_loadu_ps(p+4);
+        r[0] = _mm_shuffle_ps(a,b,_MM_SHUFFLE(2,0,2,0));
+        r[1] = _mm_shuffle_ps(a,b,_MM_SHUFFLE(3,1,3,1));
+      }
+      static RTS_ALWAYS_INLINE void store(float * p, const __m128 (&r)[2]) noexcept {
+        _mm_storeu_ps(p, _mm_unpacklo_ps(r[0],r[1]));
+        _mm_storeu_ps(p+4, _mm_unpackhi_ps(r[0],r[1]));
+      }
+    };
+
+    template <>
+    struct interleave_ps128<3> {
+      static RTS_ALWAYS_INLINE void load(const float * p, __m128 (&r)[3]) noexcept {
+        r[0] = _mm_loadu_ps(p); r[1] = _mm_loadu_ps(p+4); r[2] = _mm_loadu_ps(p+8);
+        deinterleave3_ps(r[0],r[1],r[2]);
+      }
+      static RTS_ALWAYS_INLINE void store(float * p, const __m128 (&r)[3]) noexcept {
+        __m128 a = r[0], b = r[1], c = r[2];
+        interleave3_ps(a,b,c);
+        _mm_storeu_ps(p, a); _mm_storeu_ps(p+4, b); _mm_storeu_ps(p+8, c);
+      }
+    };
+
+    template <>
+    struct interleave_ps128<4> {
+      static RTS_ALWAYS_INLINE void load(const float * p, __m128 (&r)[4]) noexcept {
+        for (int i=0;i<4;++i) r[i] = _mm_loadu_ps(p+4*i);
+        transpose4_ps(r[0],r[1],r[2],r[3]);
+      }
+      static RTS_ALWAYS_INLINE void store(float * p, const __m128 (&r)[4]) noexcept {
+        __m128 t0 = r[0], t1 = r[1], t2 = r[2], t3 = r[3];
+        transpose4_ps(t0,t1,t2,t3);
+        _mm_storeu_ps(p, t0); _mm_storeu_ps(p+4, t1); _mm_storeu_ps(p+8, t2); _mm_storeu_ps(p+12, t3);
+      }
+    };
+
+    template <>
+    struct interleave_ps128<8> {
+      // lane i is {p[8i..8i+3]} {p[8i+4..8i+7]}, so this is two 4x4 transposes
+      static RTS_ALWAYS_INLINE void load(const float * p, __m128 (&r)[8]) noexcept {
+        for (int i=0;i<4;++i) {
+          r[i] = _mm_loadu_ps(p+8*i);
+          r[i+4] = _mm_loadu_ps(p+8*i+4);
+        }
+        transpose4_ps(r[0],r[1],r[2],r[3]);
+        transpose4_ps(r[4],r[5],r[6],r[7]);
+      }
+      static RTS_ALWAYS_INLINE void store(float * p, const __m128 (&r)[8]) noexcept {
+        __m128 t[8];
+        for (int i=0;i<8;++i) t[i] = r[i];
+        transpose4_ps(t[0],t[1],t[2],t[3]);
+        transpose4_ps(t[4],t[5],t[6],t[7]);
+        for (int i=0;i<4;++i) {
+          _mm_storeu_ps(p+8*i, t[i]);
+          _mm_storeu_ps(p+8*i+4, t[i+4]);
+        }
+      }
+    };
+#endif
+
+    // vec types whose lanes are 32 bits wide and live in one register, with the kernels that transpose them
+    template <class T, class A>
+    struct packed32 : std::false_type {};
+
+#ifdef __AVX__
+    #define RTS_PACKED32(T,A,R,kernel,to_ps,from_ps) \
+      template <> \
+      struct packed32<T,A> : std::true_type { \
+        using reg = R; \
+        template <int K> using interleave = kernel<K>; \
+        static RTS_ALWAYS_INLINE reg get(const vec<T,A> & v) noexcept { return to_ps(v.m); } \
+        static RTS_ALWAYS_INLINE void put(vec<T,A> & v, reg r) noexcept { v.m = from_ps(r); } \
+      };
+
+    #define RTS_ID(x) (x)
+
+    RTS_PACKED32(float,target::avx_4,__m128,interleave_ps128,RTS_ID,RTS_ID)
+    RTS_PACKED32(float,target::avx_8,__m256,interleave_ps256,RTS_ID,RTS_ID)
+    RTS_PACKED32(std::int32_t,target::avx_4,__m128,interleave_ps128,_mm_castsi128_ps,_mm_castps_si128)
+    RTS_PACKED32(std::int32_t,target::avx_8,__m256,interleave_ps256,_mm256_castsi256_ps,_mm256_castps_si256)
+#ifdef __AVX2__
+    RTS_PACKED32(float,target::avx2_8,__m256,interleave_ps256,RTS_ID,RTS_ID)
+    RTS_PACKED32(std::int32_t,target::avx2_8,__m256,interleave_ps256,_mm256_castsi256_ps,_mm256_castps_si256)
+#endif
+
+    #undef RTS_ID
+    #undef RTS_PACKED32
+#endif
+
+    template <int K, class T, class A>
+    RTS_ALWAYS_INLINE void load_interleaved(vec<T,A> (&v)[K], const T * p, std::false_type) noexcept(std::is_nothrow_copy_assignable<T>::value) {
+      for (int i=0;i<A::width;++i)
+        for (int k=0;k<K;++k) v[k].put(i, p[i*K+k]);
+    }
+
+    template <int K, class T, class A>
+    RTS_ALWAYS_INLINE void load_interleaved(vec<T,A> (&v)[K], const T * p, std::true_type) noexcept {
+      using P = packed32<T,A>;
+      typename P::reg r[K];
+      P::template interleave<K>::load(reinterpret_cast<const float *>(p), r);
+      for (int k=0;k<K;++k) P::put(v[k], r[k]);
+    }
+
+    template <int K, class T, class A>
+    RTS_ALWAYS_INLINE void store_interleaved(T * p, const vec<T,A> (&v)[K], std::false_type) noexcept(std::is_nothrow_copy_assignable<T>::value) {
+      for (int i=0;i<A::width;++i)
+        for (int k=0;k<K;++k) p[i*K+k] = v[k].get(i);
+    }
+
+    template <int K, class T, class A>
+    RTS_ALWAYS_INLINE void store_interleaved(T * p, const vec<T,A> (&v)[K], std::true_type) noexcept {
+      using P = packed32<T,A>;
+      typename P::reg r[K];
+      for (int k=0;k<K;++k) r[k] = P::get(v[k]);
+      P::template interleave<K>::store(reinterpret_cast<float *>(p), r);
+    }
+
+    // every field is a packed 32 bit lane, and the struct is exactly those fields
+    template <class S, class A, class ... Ts>
+    struct packed32_struct : std::integral_constant<bool,
+      sizeof(S) == 4 * sizeof...(Ts) &&
+      std::is_same<std::integer_sequence<bool,packed32<Ts,A>::value...>, std::integer_sequence<bool,(sizeof(Ts),true)...>>::value
+    > {};
+
+    // which 32 bit word of the struct holds a field. constant folded, and copes with std::tuple storing its fields in reverse.
+    template <class S, class F>
+    RTS_ALWAYS_INLINE int word_of(const S & s, const F & f) noexcept {
+      return int((reinterpret_cast<const char *>(&f) - reinterpret_cast<const char *>(&s)) >> 2);
+    }
+
+    template <class A, class ... Ts, std::size_t ... Is>
+    RTS_ALWAYS_INLINE void load_struct(vec<std::tuple<Ts...>,A> & v, const std::tuple<Ts...> * p, std::index_sequence<Is...>, std::true_type) noexcept {
+      static const int K = sizeof...(Ts);
+      typename packed32<std::int32_t,A>::reg r[K];
+      packed32<std::int32_t,A>::template interleave<K>::load(reinterpret_cast<const float *>(p), r);
+      RTS_UNUSED auto l = { (packed32<Ts,A>::put(std::get<Is>(v.data), r[word_of(*p, std::get<Is>(*p))]), 0)... };
+    }
+
+    template <class A, class ... Ts, std::size_t ... Is>
+    RTS_ALWAYS_INLINE void load_struct(vec<std::tuple<Ts...>,A> & v, const std::tuple<Ts...> * p, std::index_sequence<Is...>, std::false_type) noexcept(noexcept(v.put(0,*p))) {
+      for (int i=0;i<A::width;++i) v.put(i,p[i]);
+    }
+
+    template <class A, class ... Ts, std::size_t ... Is>
+    RTS_ALWAYS_INLINE void store_struct(std::tuple<Ts...> * p, const vec<std::tuple<Ts...>,A> & v, std::index_sequence<Is...>, std::true_type) noexcept {
+      static const int K = sizeof...(Ts);
+      typename packed32<std::int32_t,A>::reg r[K];
+      RTS_UNUSED auto l = { (r[word_of(*p, std::get<Is>(*p))] = packed32<Ts,A>::get(std::get<Is>(v.data)), 0)... };
+      packed32<std::int32_t,A>::template interleave<K>::store(reinterpret_cast<float *>(p), r);
+    }
+
+    template <class A, class ... Ts, std::size_t ... Is>
+    RTS_ALWAYS_INLINE void store_struct(std::tuple<Ts...> * p, const vec<std::tuple<Ts...>,A> & v, std::index_sequence<Is...>, std::false_type) noexcept(noexcept(p[0] = v.get(0))) {
+      for (int i=0;i<A::width;++i) p[i] = v.get(i);
+    }
+
+    template <class A, class S, class T>
+    RTS_ALWAYS_INLINE void load_struct(vec<std::pair<S,T>,A> & v, const std::pair<S,T> * p, std::true_type) noexcept {
+      typename packed32<std::int32_t,A>::reg r[2];
+      packed32<std::int32_t,A>::template interleave<2>::load(reinterpret_cast<const float *>(p), r);
+      packed32<S,A>::put(v.first, r[word_of(*p, p->first)]);
+      packed32<T,A>::put(v.second, r[word_of(*p, p->second)]);
+    }
+
+    template <class A, class S, class T>
+    RTS_ALWAYS_INLINE void load_struct(vec<std::pair<S,T>,A> & v, const std::pair<S,T> * p, std::false_type) noexcept(noexcept(v.put(0,*p))) {
+      for (int i=0;i<A::width;++i) v.put(i,p[i]);
+    }
+
+    template <class A, class S, class T>
+    RTS_ALWAYS_INLINE void store_struct(std::pair<S,T> * p, const vec<std::pair<S,T>,A> & v, std::true_type) noexcept {
+      typename packed32<std::int32_t,A>::reg r[2];
+      r[word_of(*p, p->first)] = packed32<S,A>::get(v.first);
+      r[word_of(*p, p->second)] = packed32<T,A>::get(v.second);
+      packed32<std::int32_t,A>::template interleave<2>::store(reinterpret_cast<float *>(p), r);
+    }
+
+    template <class A, class S, class T>
+    RTS_ALWAYS_INLINE void store_struct(std::pair<S,T> * p, const vec<std::pair<S,T>,A> & v, std::false_type) noexcept(noexcept(p[0] = v.get(0))) {
+      for (int i=0;i<A::width;++i) p[i] = v.get(i);
+    }
+  }
+
+  /// load @p A::width consecutive structures of @p K fields of type @p T from @p p, sending field @p k of lane @p i to @p v[k].
+  ///
+  /// @p K of 2, 3, 4 and 8 transpose in registers for 32 bit lanes. @p p needs no particular alignment.
+  template <int K, class T, class A>
+  RTS_ALWAYS_INLINE void load_interleaved(vec<T,A> (&v)[K], const T * p) noexcept(noexcept(detail::load_interleaved<K>(v, p, detail::packed32<T,A>{}))) {
+    detail::load_interleaved<K>(v, p, detail::packed32<T,A>{});
+  }
+
+  /// the inverse of @p load_interleaved
+  template <int K, class T, class A>
+  RTS_ALWAYS_INLINE void store_interleaved(T * p, const vec<T,A> (&v)[K]) noexcept(noexcept(detail::store_interleaved<K>(p, v, detail::packed32<T,A>{}))) {
+    detail::store_interleaved<K>(p, v, detail::packed32<T,A>{});
+  }
+
+  /// load @p A::width consecutive tuples, one field per member @p vec
+  template <class A, class ... Ts>
+  RTS_ALWAYS_INLINE void load(vec<std::tuple<Ts...>,A> & v, const std::tuple<Ts...> * p) noexcept(
+    noexcept(detail::load_struct(v, p, std::index_sequence_for<Ts...>{}, detail::packed32_struct<std::tuple<Ts...>,A,Ts...>{}))
+  ) {
+    detail::load_struct(v, p, std::index_sequence_for<Ts...>{}, detail::packed32_struct<std::tuple<Ts...>,A,Ts...>{});
+  }
+
+  /// store @p A::width consecutive tuples
+  template <class A, class ... Ts>
+  RTS_ALWAYS_INLINE void store(std::tuple<Ts...> * p, const vec<std::tuple<Ts...>,A> & v) noexcept(
+    noexcept(detail::store_struct(p, v, std::index_sequence_for<Ts...>{}, detail::packed32_struct<std::tuple<Ts...>,A,Ts...>{}))
+  ) {
+    detail::store_struct(p, v, std::index_sequence_for<Ts...>{}, detail::packed32_struct<std::tuple<Ts...>,A,Ts...>{});
+  }
+
+  /// load @p A::width consecutive pairs
+  template <class A, class S, class T>
+  RTS_ALWAYS_INLINE void load(vec<std::pair<S,T>,A> & v, const std::pair<S,T> * p) noexcept(
+    noexcept(detail::load_struct(v, p, detail::packed32_struct<std::pair<S,T>,A,S,T>{}))
+  ) {
+    detail::load_struct(v, p, detail::packed32_struct<std::pair<S,T>,A,S,T>{});
+  }
+
+  /// store @p A::width consecutive pairs
+  template <class A, class S, class T>
+  RTS_ALWAYS_INLINE void store(std::pair<S,T> * p, const vec<std::pair<S,T>,A> & v) noexcept(
+    noexcept(detail::store_struct(p, v, detail::packed32_struct<std::pair<S,T>,A,S,T>{}))
+  ) {
+    detail::store_struct(p, v, detail::packed32_struct<std::pair<S,T>,A,S,T>{});
+  }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+#include "pool.hpp"
+#include "varying.hpp"
+
+/// @file rts/launch.hpp
+/// @brief ispc style tasks: SPMD kernels launched across a worker pool
+
+namespace rts {
+  /// a set of launched SPMD tasks, run across a worker pool by @p sync.
+  ///
+  /// Each @p launch(count, kernel) adds @p count tasks that call @p kernel(task_index, task_count). As in ispc, a task
+  /// may run at any point up to the next @p sync, which returns once all of them have finished. Here they all start
+  /// in @p sync, shared over the pool a task at a time, so uneven tasks balance out. Every task starts with a full
+  /// @p execution_mask<A> whichever thread runs it, and the thread calling @p sync gets its own mask back afterwards.
+  template <class A = default_isa>
+  class task_group {
+  public:
+    explicit task_group(worker_pool & pool = default_worker_pool()) noexcept : pool_(pool) {}
+    task_group(const task_group &) = delete;
+    task_group & operator = (const task_group &) = delete;
+
+    /// runs anything still pending. call @p sync first to see exceptions from the tasks
+    ~task_group() {
+      try { sync(); } catch (...) {}
+    }
+
+    /// add @p count tasks of @p kernel(task_index, task_count). a task that launches more needs a task_group of its own
+    template <class F>
+    void launch(std::size_t count, F kernel) {
+      if (count == 0) return;
+      launches_.push_back(batch { count, std::function<void(std::size_t, std::size_t)>(std::move(kernel)) });
+      pending_ += count;
+    }
+
+    /// run every task launched since the last sync, and wait for them. the first exception thrown by a task is
+    /// rethrown here, and the tasks that had not started by then are dropped.
+    void sync() {
+      if (launches_.empty()) return;
+      std::vector<batch> batches;
+      batches.swap(launches_);
+      const std::size_t n = pending_;
+      pending_ = 0;
+      std::vector<std::size_t> starts(1, 0);
+      for (auto && b : batches) starts.push_back(starts.back() + b.count);
+      // the calling thread runs tasks as well, so keep its masks for the code around the sync
+      detail::function_scope<A> caller;
+      pool_.parallel_for(n, [&](std::size_t i) {
+        const std::size_t b = std::size_t(std::upper_bound(starts.begin() + 1, starts.end(), i) - starts.begin()) - 1;
+        reset_execution_mask<A>();
+        batches[b].kernel(i - starts[b], batches[b].count);
+      });
+    }
+
+    /// the number of tasks launched since the last sync
+    std::size_t pending() const noexcept { return pending_; }
+
+  private:
+    struct batch {
+      std::size_t count;
+      std::function<void(std::size_t, std::size_t)> kernel;
+    };
+
+    worker_pool & pool_;
+    std::vector<batch> launches_;
+    std::size_t pending_ = 0;
+  };
+
+  /// run @p count tasks of @p kernel(task_index, task_count) on @p pool and wait for them: a launch and a sync
+  template <class A = default_isa, class F>
+  void launch(std::size_t count, F kernel, worker_pool & pool = default_worker_pool()) {
+    task_group<A> tasks(pool);
+    tasks.launch(count, std::move(kernel));
+    tasks.sync();
+  }
+}
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+#include <utility>
+#include "soa.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// @file rts/mapped_soa.hpp
+/// @brief soa columns that live in a memory mapped file
+
+#ifndef _WIN32
+
+namespace rts {
+  template <class T, class A = default_isa> struct mapped_soa;
+
+  namespace detail {
+    template <class T, class A> struct soa_operand<mapped_soa<T,A>> { using type = soa_ref<mapped_soa<T,A>,dynamic_size,A>; };
+  }
+
+  /// how @p mapped_soa maps its file
+  struct map_options {
+    bool writable = false;   ///< map read-write and share stores with the file, rather than read-only
+    bool populate = false;   ///< fault every page in up front (MAP_POPULATE), where supported
+    bool huge_pages = false; ///< ask for transparent huge pages (MADV_HUGEPAGE), where supported
+    bool sequential = true;  ///< tell the kernel the column will be read in order, so it reads ahead aggressively
+  };
+
+  /// a column of @p T stored in a file as a plain array of @p T, mapped so expressions read and write the page cache directly.
+  ///
+  /// The file holds @p size() values and nothing else. The mapping is page aligned, so it meets @p A::alignment. The last
+  /// vector may run past the end of the file into the rest of its page: those lanes read as zero, and stores to them never reach the file.
+  template <class T, class A>
+  struct mapped_soa : detail::soa_expr<mapped_soa<T,A>,dynamic_size,A> {
+    using arch = A;
+    using vector = vec<T,A>;
+    using value_type = T;
+    using size_type = std::size_t;
+
+    static_assert(sizeof(vector) == sizeof(T) * A::width, "mapped_soa needs vec<T,A> to be laid out as a plain array of T");
+
+  private:
+    vector * data_;
+    std::size_t size_;  // in elements
+    std::size_t bytes_; // mapped
+    int fd_;
+    bool writable_;     // mapped PROT_WRITE
+
+    [[noreturn]] static void fail(const char * what) { throw std::system_error(errno, std::generic_category(), what); }
+
+    void map(int fd, std::size_t n, const map_options & options) {
+      fd_ = fd;
+      size_ = n;
+      writable_ = options.writable;
+      bytes_ = std::size_t(vsize()) * sizeof(vector);
+      if (bytes_ == 0) return;
+      int flags = MAP_SHARED;
+    #ifdef MAP_POPULATE
+      if (options.populate) flags |= MAP_POPULATE;
+    #endif
+      void * p = mmap(nullptr, bytes_, options.writable ? PROT_READ | PROT_WRITE : PROT_READ, flags, fd, 0);
+      if (p == MAP_FAILED) {
+        int e = errno;
+        close(fd_);
+        fd_ = -1;
+        errno = e;
+        fail("mmap");
+      }
+      data_ = static_cast<vector *>(p);
+      if (options.sequential) madvise(p, bytes_, MADV_SEQUENTIAL);
+    #ifdef MADV_HUGEPAGE
+      if (options.huge_pages) madvise(p, bytes_, MADV_HUGEPAGE);
+    #endif
+    }
+
+    void release() noexcept {
+      if (data_ != nullptr) munmap(data_, bytes_);
+      if (fd_ >= 0) close(fd_);
+      data_ = nullptr;
+      size_ = bytes_ = 0;
+      fd_ = -1;
+      writable_ = false;
+    }
+
+  public:
+    RTS_ALWAYS_INLINE mapped_soa() noexcept : data_(nullptr), size_(0), bytes_(0), fd_(-1), writable_(false) {}
+
+    /// map an existing file of @p T values
+    explicit mapped_soa(const char * path, const map_options & options = map_options()) : mapped_soa() {
+      int fd = open(path, options.writable ? O_RDWR : O_RDONLY);
+      if (fd < 0) fail("open");
+      struct stat st;
+      if (fstat(fd, &st) != 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        fail("fstat");
+      }
+      map(fd, std::size_t(st.st_size) / sizeof(T), options);
+    }
+
+    /// create or truncate @p path to hold @p n zeroed values of @p T, and map it writable
+    static mapped_soa create(const char * path, std::size_t n, map_options options = map_options()) {
+      options.writable = true;
+      int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+      if (fd < 0) fail("open");
+      if (ftruncate(fd, off_t(n * sizeof(T))) != 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        fail("ftruncate");
+      }
+      mapped_soa result;
+      result.map(fd, n, options);
+      return result;
+    }
+
+    mapped_soa(const mapped_soa &) = delete;
+    mapped_soa & operator = (const mapped_soa &) = delete;
+
+    RTS_ALWAYS_INLINE mapped_soa(mapped_soa && rhs) noexcept : data_(rhs.data_), size_(rhs.size_), bytes_(rhs.bytes_), fd_(rhs.fd_), writable_(rhs.writable_) {
+      rhs.data_ = nullptr;
+      rhs.size_ = rhs.bytes_ = 0;
+      rhs.fd_ = -1;
+      rhs.writable_ = false;
+    }
+
+    RTS_ALWAYS_INLINE mapped_soa & operator = (mapped_soa && rhs) noexcept {
+      swap(rhs);
+      return *this;
+    }
+
+    ~mapped_soa() noexcept { release(); }
+
+    RTS_ALWAYS_INLINE void swap(mapped_soa & rhs) noexcept {
+      std::swap(data_,rhs.data_);
+      std::swap(size_,rhs.size_);
+      std::swap(bytes_,rhs.bytes_);
+      std::swap(fd_,rhs.fd_);
+      std::swap(writable_,rhs.writable_);
+    }
+
+    /// write dirty pages back to the file, waiting for them if @p wait
+    void flush(bool wait = true) {
+      if (data_ != nullptr && msync(data_, bytes_, wait ? MS_SYNC : MS_ASYNC) != 0) fail("msync");
+    }
+
+    /// pass an madvise hint such as @p MADV_WILLNEED or @p MADV_DONTNEED for the whole mapping
+    void advise(int advice) noexcept {
+      if (data_ != nullptr) madvise(data_, bytes_, advice);
+    }
+
+    RTS_ALWAYS_INLINE RTS_PURE bool is_open() const noexcept { return fd_ >= 0; }
+    /// whether the column was mapped with @p map_options::writable, so that assignments may store to it
+    RTS_ALWAYS_INLINE RTS_PURE bool writable() const noexcept { return writable_; }
+
+    /// throw @p std::system_error with @p EACCES unless the mapping is writable, rather than fault on the first store
+    void check_writable() const {
+      if (!writable_ && size_ != 0) throw std::system_error(EACCES, std::generic_category(), "mapped_soa: mapped read-only");
+    }
+    RTS_ALWAYS_INLINE RTS_PURE std::size_t size() const noexcept { return size_; }
+    RTS_ALWAYS_INLINE RTS_PURE bool empty() const noexcept { return size_ == 0; }
+    RTS_ALWAYS_INLINE RTS_PURE std::size_t length() const noexcept { return size_; }
+    RTS_ALWAYS_INLINE RTS_PURE int vsize() const noexcept { return int((size_ + A::shift_mask) >> A::shift); }
+    RTS_ALWAYS_INLINE RTS_PURE int wsize() const noexcept { return int(size_ >> A::shift); }
+    RTS_ALWAYS_INLINE RTS_PURE bool needs_last() const noexcept { return (size_ & A::shift_mask) != 0; }
+    RTS_ALWAYS_INLINE RTS_PURE vec<bool,A> last_mask() const noexcept { return detail::first_lanes<A>(int(size_ & A::shift_mask)); }
+
+    RTS_ALWAYS_INLINE RTS_CONST vector * vdata() noexcept { return data_; }
+    RTS_ALWAYS_INLINE RTS_CONST const vector * vdata() const noexcept { return data_; }
+    RTS_ALWAYS_INLINE RTS_CONST const vector & vget(int i) const noexcept { return data_[i]; }
+    RTS_ALWAYS_INLINE RTS_CONST const vector & vget(int i, const vec<bool,A> &) const noexcept { return data_[i]; }
+    RTS_ALWAYS_INLINE void prefetch(int i) const noexcept { _mm_prefetch(reinterpret_cast<const char *>(data_ + i), _MM_HINT_T0); }
+    RTS_ALWAYS_INLINE RTS_PURE auto get(std::size_t i) const noexcept { return data_[i >> A::shift].get(int(i & A::shift_mask)); }
+    RTS_ALWAYS_INLINE void put(std::size_t i, const T & v) noexcept { data_[i >> A::shift].put(int(i & A::shift_mask), v); }
+
+    RTS_ALWAYS_INLINE void vput(int i, const vector & v) noexcept { data_[i] = v; }
+    RTS_ALWAYS_INLINE void vstream(int i, const vector & v) noexcept { stream(data_[i], v); }
+
+    #define RTS_SOA_ASSIGN(op) \
+      template <typename Base> \
+      RTS_ALWAYS_INLINE mapped_soa & operator op (const detail::soa_expr<Base,dynamic_size,A> & rhs) { \
+        check_writable(); \
+        int i = 0, w = wsize(); \
+        for (;i < w; ++i) \
+          data_[i] op rhs.vget(i); \
+        if (needs_last()) { \
+          /* lane by lane, so the zero lanes past the end of the file are never divided by */ \
+          const auto r = rhs.vget(i,last_mask()); \
+          for (int l=0, n=int(size_ & A::shift_mask);l < n;++l) { \
+            T x = data_[i].get(l); \
+            x op r.get(l); \
+            data_[i].put(l, x); \
+          } \
+        } \
+        return *this; \
+      }
+
+    RTS_SOA_ASSIGN(=)
+    RTS_SOA_ASSIGN(+=)
+    RTS_SOA_ASSIGN(-=)
+    RTS_SOA_ASSIGN(*=)
+    RTS_SOA_ASSIGN(/=)
+    RTS_SOA_ASSIGN(%=)
+    RTS_SOA_ASSIGN(<<=)
+    RTS_SOA_ASSIGN(>>=)
+    RTS_SOA_ASSIGN(&=)
+    RTS_SOA_ASSIGN(|=)
+    RTS_SOA_ASSIGN(^=)
+
+    #undef RTS_SOA_ASSIGN
+  };
+
+  /// @p stream_assign for @p mapped_soa
+  template <class T, class A, class Base>
+  void stream_assign(mapped_soa<T,A> & dst, const detail::soa_expr<Base,dynamic_size,A> & rhs, std::size_t prefetch_distance = default_prefetch_distance) {
+    dst.check_writable();
+    detail::stream_eval(dst, rhs, dst.wsize(), dst.needs_last(), prefetch_distance);
+  }
+}
+
+#endif // _WIN32
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include "pool.hpp"
+#include "soa.hpp"
+#include "soa_vector.hpp"
+
+/// @file rts/parallel.hpp
+/// @brief evaluating soa expressions across a worker pool
+
+namespace rts {
+  /// default number of destination bytes each worker evaluates at a time, small enough that a chunk of
+  /// the destination and a few source columns stay in a private L2
+  static const std::size_t default_grain_bytes = 64 * 1024;
+
+  namespace detail {
+    // the loop behind par_assign: chunks of grain vectors, the last one finishing under last_mask
+    template <class D, class Base, std::size_t N, class A>
+    void par_eval(worker_pool & pool, D & dst, const soa_expr<Base,N,A> & rhs, int wsize, bool needs_last, std::size_t grain) {
+      using vector = typename D::vector;
+      const int vsize = wsize + (needs_last ? 1 : 0);
+      if (vsize == 0) return;
+      if (grain == 0) grain = default_grain_bytes / sizeof(vector) << A::shift;
+      const int step = int(std::max<std::size_t>(1, (grain + A::shift_mask) >> A::shift)); // in vectors
+      const std::size_t chunks = std::size_t((vsize + step - 1) / step);
+      pool.parallel_for(chunks, [&](std::size_t c) {
+        const int lo = int(c) * step;
+        const int hi = std::min(lo + step, wsize);
+        for (int i = lo; i < hi; ++i)
+          dst.vput(i, rhs.vget(i));
+        if (needs_last && lo + step > wsize)
+          dst.vput(wsize, rhs.vget(wsize, dst.last_mask()));
+      });
+    }
+  }
+
+  /// evaluate @p rhs into @p dst, splitting the vectors of @p dst into chunks of @p grain elements shared out over @p pool.
+  ///
+  /// Every worker evaluates the same expression tree over its own chunks. @p grain is rounded up to whole vectors,
+  /// 0 picks chunks of @p default_grain_bytes of the destination. @p rhs must not read @p dst at other indices.
+  template <class T, std::size_t N, class A, class Base>
+  void par_assign(soa<T,N,A> & dst, const detail::soa_expr<Base,N,A> & rhs, std::size_t grain = 0, worker_pool & pool = default_worker_pool()) {
+    detail::par_eval(pool, dst, rhs, soa<T,N,A>::wsize, soa<T,N,A>::needs_last, grain);
+  }
+
+  /// @p par_assign for @p soa_vector
+  template <class T, class A, class Base>
+  void par_assign(soa_vector<T,A> & dst, const detail::soa_expr<Base,dynamic_size,A> & rhs, std::size_t grain = 0, worker_pool & pool = default_worker_pool()) {
+    detail::par_eval(pool, dst, rhs, dst.wsize(), dst.needs_last(), grain);
+  }
+}
@@ -0,0 +1,104 @@
+#include "pool.hpp"
+
+namespace rts {
+  namespace {
+    // the pool whose loop this thread is running, if any. nested loops on it run inline.
+    thread_local const worker_pool * current_pool = nullptr;
+  }
+
+  unsigned worker_pool::default_threads() noexcept {
+    unsigned n = std::thread::hardware_concurrency();
+    return n > 1 ? n - 1 : 0;
+  }
+
+  worker_pool::worker_pool(unsigned threads) {
+    workers.reserve(threads);
+    try {
+      for (unsigned i=0;i<threads;++i)
+        workers.emplace_back([this] { run(); });
+    } catch (...) {
+      stop(); // the destructor will not run, and a joinable std::thread would terminate
+      throw;
+    }
+  }
+
+  worker_pool::~worker_pool() {
+    stop();
+  }
+
+  void worker_pool::stop() noexcept {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (auto && t : workers) t.join();
+  }
+
+  void worker_pool::work(const std::function<void(std::size_t)> & f, std::size_t n) noexcept {
+    const worker_pool * saved = current_pool;
+    current_pool = this;
+    for (std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < n;) {
+      try {
+        f(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) error = std::current_exception();
+        next.store(n, std::memory_order_relaxed); // abandon the rest of the loop
+      }
+    }
+    current_pool = saved;
+  }
+
+  void worker_pool::run() noexcept {
+    std::size_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+      wake.wait(lock, [&] { return stopping || generation != seen; });
+      if (stopping) return;
+      seen = generation;
+      // a worker that wakes after the loop has finished has nothing to join
+      const std::function<void(std::size_t)> * f = job;
+      const std::size_t n = job_size;
+      if (f == nullptr) continue;
+      ++busy;
+      lock.unlock();
+      work(*f, n);
+      lock.lock();
+      if (--busy == 0) done.notify_one();
+    }
+  }
+
+  void worker_pool::parallel_for(std::size_t n, const std::function<void(std::size_t)> & f) {
+    if (n == 0) return;
+    if (current_pool == this || workers.empty() || n == 1) {
+      for (std::size_t i=0;i<n;++i) f(i);
+      return;
+    }
+    std::lock_guard<std::mutex> loop(loop_mutex);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      job = &f;
+      job_size = n;
+      next.store(0, std::memory_order_relaxed);
+      error = nullptr;
+      ++generation;
+    }
+    wake.notify_all();
+    work(f, n);
+    std::exception_ptr e;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      done.wait(lock, [&] { return busy == 0; });
+      job = nullptr;
+      e = error;
+      error = nullptr;
+    }
+    if (e) std::rethrow_exception(e);
+  }
+
+  worker_pool & default_worker_pool() {
+    static worker_pool pool;
+    return pool;
+  }
+}
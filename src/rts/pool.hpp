@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @file rts/pool.hpp
+/// @brief a fixed set of worker threads for data parallel loops
+
+namespace rts {
+  /// a fixed set of worker threads that share the iterations of one loop at a time.
+  ///
+  /// The calling thread takes part in every loop, so a pool of @p n threads runs @p n+1 wide.
+  class worker_pool {
+  public:
+    /// start @p threads workers. the default leaves one hardware thread for the caller.
+    explicit worker_pool(unsigned threads = default_threads());
+    worker_pool(const worker_pool &) = delete;
+    worker_pool & operator = (const worker_pool &) = delete;
+    ~worker_pool();
+
+    /// the number of worker threads, not counting the caller
+    unsigned size() const noexcept { return unsigned(workers.size()); }
+
+    /// run @p f(i) for each @p i in [0,n) across the workers and the calling thread, and wait for all of them.
+    ///
+    /// Iterations are handed out one at a time, so make each one coarse. The first exception thrown by @p f is
+    /// rethrown here once every worker has stopped. Calls from inside a loop on the same pool run serially.
+    void parallel_for(std::size_t n, const std::function<void(std::size_t)> & f);
+
+    static unsigned default_threads() noexcept;
+
+  private:
+    void work(const std::function<void(std::size_t)> & f, std::size_t n) noexcept;
+    void run() noexcept;
+    void stop() noexcept; // wake and join every worker started so far
+
+    std::vector<std::thread> workers;
+    std::mutex loop_mutex;             // one loop at a time
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    const std::function<void(std::size_t)> * job = nullptr;
+    std::size_t job_size = 0;
+    std::atomic<std::size_t> next { 0 };
+    std::size_t generation = 0;
+    unsigned busy = 0;
+    bool stopping = false;
+    std::exception_ptr error;
+  };
+
+  /// a process-wide pool, started on first use
+  extern worker_pool & default_worker_pool();
+}
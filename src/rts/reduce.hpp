@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include "soa.hpp"
+#include "vec_intrinsics.hpp"
+#include "x86.hpp"
+
+/// @file rts/reduce.hpp
+/// @brief folding soa expressions down to a scalar in one pass
+
+namespace rts {
+  namespace detail {
+    // independent accumulators each reduction keeps in flight, enough to hide the latency of a vector add
+    static const int reduce_unroll = 4;
+
+    template <class E> using soa_vector_t = typename std::decay<decltype(std::declval<const E &>().vget(0))>::type;
+
+    struct reduce_add {
+      template <class T> RTS_ALWAYS_INLINE RTS_PURE T operator () (const T & a, const T & b) const noexcept { return a + b; }
+    };
+
+    struct reduce_min {
+      template <class T, class A> RTS_ALWAYS_INLINE RTS_PURE vec<T,A> operator () (const vec<T,A> & a, const vec<T,A> & b) const noexcept { return vec_intrinsics::min(a,b); }
+      template <class T> RTS_ALWAYS_INLINE RTS_PURE T operator () (T a, T b) const noexcept { return b < a ? b : a; }
+    };
+
+    struct reduce_max {
+      template <class T, class A> RTS_ALWAYS_INLINE RTS_PURE vec<T,A> operator () (const vec<T,A> & a, const vec<T,A> & b) const noexcept { return vec_intrinsics::max(a,b); }
+      template <class T> RTS_ALWAYS_INLINE RTS_PURE T operator () (T a, T b) const noexcept { return a < b ? b : a; }
+    };
+
+    // fold e with op, starting every lane of every accumulator at identity. lanes past e.length() are never folded in.
+    template <class Op, class Base, std::size_t N, class A, class V = soa_vector_t<Base>>
+    RTS_ALWAYS_INLINE typename V::value_type reduce_eval(const soa_expr<Base,N,A> & e, typename V::value_type identity, Op op) noexcept {
+      static_assert(reduce_unroll == 4, "reduce_eval unrolls by hand");
+      const std::size_t n = e.length();
+      const int w = int(n >> A::shift);
+      V a0(identity), a1(identity), a2(identity), a3(identity);
+      int i = 0;
+      for (;i + reduce_unroll <= w; i += reduce_unroll) {
+        a0 = op(a0, e.vget(i));
+        a1 = op(a1, e.vget(i+1));
+        a2 = op(a2, e.vget(i+2));
+        a3 = op(a3, e.vget(i+3));
+      }
+      // fewer than reduce_unroll whole vectors remain: count them once so the bound does not depend on i
+      for (int k=0, rest=w-i;k < rest;++k)
+        a0 = op(a0, e.vget(i+k));
+      i = w;
+      a0 = op(op(a0, a1), op(a2, a3));
+      if (const int tail = int(n & A::shift_mask)) {
+        V v = e.vget(i, first_lanes<A>(tail));
+        for (int j=0;j<tail;++j) a0.put(j, op(a0.get(j), v.get(j)));
+      }
+      typename V::value_type result = a0.get(0);
+      for (int j=1;j<A::width;++j) result = op(result, a0.get(j));
+      return result;
+    }
+
+    // compensated running sum
+    template <class T>
+    struct kahan {
+      T s, c;
+      RTS_ALWAYS_INLINE explicit kahan(const T & t) noexcept : s(t), c(T(0)) {}
+      RTS_ALWAYS_INLINE void add(const T & x) noexcept {
+        T y = x - c;
+        T t = s + y;
+        c = (t - s) - y;
+        s = t;
+      }
+    };
+  }
+
+  /// the sum of the elements of @p e
+  template <class Base, std::size_t N, class A>
+  RTS_ALWAYS_INLINE RTS_PURE auto sum(const detail::soa_expr<Base,N,A> & e) noexcept {
+    using T = typename detail::soa_vector_t<Base>::value_type;
+    return detail::reduce_eval(e, T(0), detail::reduce_add());
+  }
+
+  /// the sum of the elements of @p e, carrying a compensation term per lane so rounding error does not grow with the length
+  template <class Base, std::size_t N, class A>
+  RTS_PURE auto kahan_sum(const detail::soa_expr<Base,N,A> & e) noexcept {
+    using V = detail::soa_vector_t<Base>;
+    using T = typename V::value_type;
+    const std::size_t n = e.length();
+    const int w = int(n >> A::shift);
+    detail::kahan<V> a0(V(T(0))), a1(V(T(0)));
+    int i = 0;
+    for (;i + 2 <= w; i += 2) {
+      a0.add(e.vget(i));
+      a1.add(e.vget(i+1));
+    }
+    for (;i < w; ++i)
+      a0.add(e.vget(i));
+    detail::kahan<T> result(T(0));
+    for (int j=0;j<A::width;++j) {
+      result.add(a0.s.get(j));
+      result.add(a1.s.get(j));
+      result.add(-a0.c.get(j));
+      result.add(-a1.c.get(j));
+    }
+    if (const int tail = int(n & A::shift_mask)) {
+      V v = e.vget(i, detail::first_lanes<A>(tail));
+      for (int j=0;j<tail;++j) result.add(v.get(j));
+    }
+    return result.s;
+  }
+
+  /// the least element of @p e, or the largest value of its type if @p e is empty
+  template <class Base, std::size_t N, class A>
+  RTS_ALWAYS_INLINE RTS_PURE auto min(const detail::soa_expr<Base,N,A> & e) noexcept {
+    using T = typename detail::soa_vector_t<Base>::value_type;
+    using limits = std::numeric_limits<T>;
+    return detail::reduce_eval(e, limits::has_infinity ? limits::infinity() : limits::max(), detail::reduce_min());
+  }
+
+  /// the greatest element of @p e, or the lowest value of its type if @p e is empty
+  template <class Base, std::size_t N, class A>
+  RTS_ALWAYS_INLINE RTS_PURE auto max(const detail::soa_expr<Base,N,A> & e) noexcept {
+    using T = typename detail::soa_vector_t<Base>::value_type;
+    using limits = std::numeric_limits<T>;
+    return detail::reduce_eval(e, limits::has_infinity ? -limits::infinity() : limits::lowest(), detail::reduce_max());
+  }
+
+  /// the inner product of @p lhs and @p rhs, without materializing their product
+  template <class S, class T, std::size_t N, class A>
+  RTS_ALWAYS_INLINE RTS_PURE auto dot(const detail::soa_expr<S,N,A> & lhs, const detail::soa_expr<T,N,A> & rhs) noexcept {
+    return sum(lhs * rhs);
+  }
+
+  /// true if any element of the boolean expression @p e is set. stops at the first block of vectors with a set lane.
+  template <class Base, std::size_t N, class A>
+  RTS_PURE bool any(const detail::soa_expr<Base,N,A> & e) noexcept {
+    const std::size_t n = e.length();
+    const int w = int(n >> A::shift);
+    int i = 0;
+    for (;i + detail::reduce_unroll <= w; i += detail::reduce_unroll)
+      if (movemask(e.vget(i) | e.vget(i+1) | e.vget(i+2) | e.vget(i+3))) return true;
+    for (;i < w; ++i)
+      if (movemask(e.vget(i))) return true;
+    if (const int tail = int(n & A::shift_mask)) {
+      const vec<bool,A> m = detail::first_lanes<A>(tail);
+      return (movemask(e.vget(i, m)) & movemask(m)) != 0;
+    }
+    return false;
+  }
+
+  /// true if every element of the boolean expression @p e is set. stops at the first block of vectors with a clear lane.
+  template <class Base, std::size_t N, class A>
+  RTS_PURE bool all(const detail::soa_expr<Base,N,A> & e) noexcept {
+    const std::uint32_t full = A::width_mask;
+    const std::size_t n = e.length();
+    const int w = int(n >> A::shift);
+    int i = 0;
+    for (;i + detail::reduce_unroll <= w; i += detail::reduce_unroll)
+      if (movemask(e.vget(i) & e.vget(i+1) & e.vget(i+2) & e.vget(i+3)) != full) return false;
+    for (;i < w; ++i)
+      if (movemask(e.vget(i)) != full) return false;
+    if (const int tail = int(n & A::shift_mask)) {
+      const vec<bool,A> m = detail::first_lanes<A>(tail);
+      return (movemask(e.vget(i, m)) & movemask(m)) == movemask(m);
+    }
+    return true;
+  }
+
+  /// the number of set elements of the boolean expression @p e
+  template <class Base, std::size_t N, class A>
+  RTS_PURE std::size_t count(const detail::soa_expr<Base,N,A> & e) noexcept {
+    const std::size_t n = e.length();
+    const int w = int(n >> A::shift);
+    std::size_t c0 = 0, c1 = 0;
+    int i = 0;
+    for (;i + 2 <= w; i += 2) {
+      c0 += popcnt(movemask(e.vget(i)));
+      c1 += popcnt(movemask(e.vget(i+1)));
+    }
+    for (;i < w; ++i)
+      c0 += popcnt(movemask(e.vget(i)));
+    if (const int tail = int(n & A::shift_mask)) {
+      const vec<bool,A> m = detail::first_lanes<A>(tail);
+      c0 += popcnt(movemask(e.vget(i, m)) & movemask(m));
+    }
+    return c0 + c1;
+  }
+}
@@ -1,42 +1,82 @@
 #pragma once
 
 #include <immintrin.h>
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cstdint>
 #include <functional>
+#include <tuple>
+#include <type_traits>
 #include "vec.hpp"
 
 namespace rts {
 
+  template <class T, std::size_t N, class A> struct soa;
+
+  /// the extent of expressions over containers whose length is only known at runtime, such as @p soa_vector
+  static const std::size_t dynamic_size = ~std::size_t(0);
+
+  /// default distance, in bytes of each source column, that @p stream_assign prefetches ahead of the loads
+  static const std::size_t default_prefetch_distance = 1024;
+
   namespace detail {
     template <class Base, std::size_t N, class A = default_isa>
     struct soa_expr {
-      using vector = typename Base::vector;
-      // auto?
-      RTS_ALWAYS_INLINE RTS_PURE vector vget(int i) const noexcept { return static_cast<const Base*>(this)->vget(i); }
-      RTS_ALWAYS_INLINE RTS_PURE vector vget(int i, const vec<bool,A> & mask) const noexcept { return static_cast<const Base*>(this)->vget(i, mask); }
+      RTS_ALWAYS_INLINE RTS_PURE decltype(auto) vget(int i) const noexcept { return static_cast<const Base*>(this)->vget(i); }
+      // vector i where only the lanes in mask matter, as for the last vector of a length that is not a multiple of the width.
+      // the other lanes hold unspecified values, but computing them never traps
+      RTS_ALWAYS_INLINE RTS_PURE decltype(auto) vget(int i, const vec<bool,A> & mask) const noexcept { return static_cast<const Base*>(this)->vget(i, mask); }
+      // hint that vector i of every leaf will be read soon
+      RTS_ALWAYS_INLINE void prefetch(int i) const noexcept { static_cast<const Base*>(this)->prefetch(i); }
+      // the number of elements the expression produces
+      RTS_ALWAYS_INLINE RTS_PURE std::size_t length() const noexcept { return static_cast<const Base*>(this)->length(); }
       RTS_ALWAYS_INLINE RTS_CONST constexpr Base & operator () () noexcept { return *static_cast<Base*>(this); }
       RTS_ALWAYS_INLINE RTS_CONST constexpr const Base & operator () () const noexcept { return *static_cast<const Base*>(this); }
     };
 
+    template <class...> struct soa_void { using type = void; };
+
+    // the number of container operands an expression reads, for sizing tiles. containers count as one.
+    template <class S, class = void> struct soa_leaves : std::integral_constant<int,1> {};
+    template <class S> struct soa_leaves<S, typename soa_void<decltype(S::leaves)>::type> : std::integral_constant<int,S::leaves> {};
+
+    // containers are held by reference inside expressions, everything else by value
+    template <class S, std::size_t N, class A>
+    struct soa_ref : soa_expr<soa_ref<S,N,A>,N,A> {
+      using vector = typename S::vector;
+      const S & base;
+      RTS_ALWAYS_INLINE constexpr soa_ref(const S & base) noexcept : base(base) {}
+      RTS_ALWAYS_INLINE RTS_CONST constexpr const vector & vget(int i) const noexcept { return base.vget(i); }
+      RTS_ALWAYS_INLINE RTS_CONST constexpr const vector & vget(int i, const vec<bool,A> &) const noexcept { return base.vget(i); }
+      RTS_ALWAYS_INLINE void prefetch(int i) const noexcept { base.prefetch(i); }
+      RTS_ALWAYS_INLINE RTS_PURE std::size_t length() const noexcept { return base.length(); }
+    };
+
+    template <class S> struct soa_operand { using type = S; };
+    template <class T, std::size_t N, class A> struct soa_operand<soa<T,N,A>> { using type = soa_ref<soa<T,N,A>,N,A>; };
+    template <class S> using soa_operand_t = typename soa_operand<S>::type;
+
     #define RTS_SOA_OP(name,op) \
       template <class S, std::size_t N, class A = default_isa> \
       struct soa_op_##name : public soa_expr<soa_op_##name<S,N,A>,N,A> { \
-        using vector = decltype(op std::declval<typename S::vector>); \
+        using vector = decltype(op std::declval<typename S::vector>()); \
+        static const int leaves = soa_leaves<S>::value; \
         S base; \
         RTS_ALWAYS_INLINE constexpr soa_op_##name(const S & base) noexcept : base(base) {} \
         RTS_ALWAYS_INLINE soa_op_##name(S && base) noexcept : base(std::move(base)) {} \
-        RTS_ALWAYS_INLINE RTS_PURE vector vget(int i) noexcept { return op base.vget(i); } \
-        RTS_ALWAYS_INLINE RTS_PURE vector vget(int i, const vec<bool,A> & mask) noexcept { return op base.vget(i); } \
+        RTS_ALWAYS_INLINE RTS_PURE vector vget(int i) const noexcept { return op base.vget(i); } \
+        RTS_ALWAYS_INLINE RTS_PURE vector vget(int i, const vec<bool,A> & mask) const noexcept { return op base.vget(i, mask); } \
+        RTS_ALWAYS_INLINE void prefetch(int i) const noexcept { base.prefetch(i); } \
+        RTS_ALWAYS_INLINE RTS_PURE std::size_t length() const noexcept { return base.length(); } \
       }; \
       template <class S, std::size_t N, class A> \
       RTS_ALWAYS_INLINE RTS_PURE constexpr auto operator op (const soa_expr<S,N,A> & base) noexcept { \
-        return soa_op_##name<S,N,A>(base()); \
+        return soa_op_##name<soa_operand_t<S>,N,A>(base()); \
       } \
       template <class S, std::size_t N, class A> \
       RTS_ALWAYS_INLINE auto operator op (soa_expr<S,N,A> && base) noexcept { \
-        return soa_op_##name<S,N,A>(std::move(base())); \
+        return soa_op_##name<soa_operand_t<S>,N,A>(std::move(base())); \
       }
 
     RTS_SOA_OP(neg,-)
@@ -47,52 +87,134 @@ namespace rts {
 
     #undef RTS_SOA_OP
 
-    #define RTS_SOA_BINOP(name,op) \
+    // the right operand of a masked binop. leaves ignore the mask, so lanes outside it may hold anything
+    template <class V, class A>
+    RTS_ALWAYS_INLINE RTS_CONST constexpr const V & soa_lanes(const V & v, const vec<bool,A> &) noexcept { return v; }
+
+    // a divisor with 1 in the lanes outside the mask, so the lanes past the end never divide by zero
+    template <class V, class A>
+    RTS_ALWAYS_INLINE RTS_PURE V soa_divisor(V v, const vec<bool,A> & mask) noexcept {
+      const std::uint32_t m = movemask(mask);
+      for (int l=0;l<A::width;++l) if (!(m >> l & 1)) v.put(l, 1);
+      return v;
+    }
+
+    #define RTS_SOA_BINOP(name,op,masked) \
       template <class S, class T, std::size_t N, class A = default_isa> \
       struct soa_binop_##name : public soa_expr<soa_binop_##name<S,T,N,A>,N,A> { \
-        using vector = decltype(std::declval<typename S::vector> op std::declval<typename T::vector>); \
+        using vector = decltype(std::declval<typename S::vector>() op std::declval<typename T::vector>()); \
+        static const int leaves = soa_leaves<S>::value + soa_leaves<T>::value; \
         S lhs; \
         T rhs; \
         RTS_ALWAYS_INLINE constexpr soa_binop_##name(const S & lhs, const T & rhs) noexcept : lhs(lhs), rhs(rhs) {} \
         RTS_ALWAYS_INLINE soa_binop_##name(S && lhs, T && rhs) noexcept : lhs(std::move(lhs)), rhs(std::move(rhs)) {} \
-        RTS_ALWAYS_INLINE RTS_PURE vector vget(int i) noexcept { return lhs.vget(i) op rhs.vget(i); } \
-        RTS_ALWAYS_INLINE RTS_PURE vector vget(int i, const vec<bool,A> & mask) noexcept { return lhs.vget(i, mask) op rhs.vget(i, mask); } \
+        RTS_ALWAYS_INLINE RTS_PURE vector vget(int i) const noexcept { return lhs.vget(i) op rhs.vget(i); } \
+        RTS_ALWAYS_INLINE RTS_PURE vector vget(int i, const vec<bool,A> & mask) const noexcept { return lhs.vget(i, mask) op masked(rhs.vget(i, mask), mask); } \
+        RTS_ALWAYS_INLINE void prefetch(int i) const noexcept { lhs.prefetch(i); rhs.prefetch(i); } \
+        RTS_ALWAYS_INLINE RTS_PURE std::size_t length() const noexcept { return lhs.length(); } \
       }; \
       \
       template <class S, class T, std::size_t N, class A> \
       RTS_ALWAYS_INLINE RTS_PURE constexpr auto operator op (const soa_expr<S,N,A> & lhs, const soa_expr<T,N,A> & rhs) noexcept { \
-        return soa_binop_##name<S,T,N,A>(lhs(), rhs()); \
+        return soa_binop_##name<soa_operand_t<S>,soa_operand_t<T>,N,A>(lhs(), rhs()); \
       } \
       template <class S, class T, std::size_t N, class A> \
       RTS_ALWAYS_INLINE auto operator op (soa_expr<S,N,A> && lhs, soa_expr<T,N,A> && rhs) noexcept { \
-        return soa_binop_##name<S,T,N,A>(lhs(), rhs()); \
+        return soa_binop_##name<soa_operand_t<S>,soa_operand_t<T>,N,A>(lhs(), rhs()); \
       }
 
-    RTS_SOA_BINOP(add,+)
-    RTS_SOA_BINOP(mul,*)
-    RTS_SOA_BINOP(sub,-)
-    RTS_SOA_BINOP(div,/)
-    RTS_SOA_BINOP(mod,%)
-    RTS_SOA_BINOP(shl,<<)
-    RTS_SOA_BINOP(shr,>>)
-    RTS_SOA_BINOP(binary_and,&)
-    RTS_SOA_BINOP(binary_or,|)
-    RTS_SOA_BINOP(xor,^)
-    RTS_SOA_BINOP(logical_and,&&)
-    RTS_SOA_BINOP(logical_or,||)
-    RTS_SOA_BINOP(lt,<)
-    RTS_SOA_BINOP(le,<=)
-    RTS_SOA_BINOP(eq,==)
-    RTS_SOA_BINOP(ge,>=)
-    RTS_SOA_BINOP(gt,>)
-    RTS_SOA_BINOP(ne,!=)
+    RTS_SOA_BINOP(add,+,soa_lanes)
+    RTS_SOA_BINOP(mul,*,soa_lanes)
+    RTS_SOA_BINOP(sub,-,soa_lanes)
+    RTS_SOA_BINOP(div,/,soa_divisor)
+    RTS_SOA_BINOP(mod,%,soa_divisor)
+    RTS_SOA_BINOP(shl,<<,soa_lanes)
+    RTS_SOA_BINOP(shr,>>,soa_lanes)
+    RTS_SOA_BINOP(binary_and,&,soa_lanes)
+    RTS_SOA_BINOP(binary_or,|,soa_lanes)
+    RTS_SOA_BINOP(xor,^,soa_lanes)
+    RTS_SOA_BINOP(logical_and,&&,soa_lanes)
+    RTS_SOA_BINOP(logical_or,||,soa_lanes)
+    RTS_SOA_BINOP(lt,<,soa_lanes)
+    RTS_SOA_BINOP(le,<=,soa_lanes)
+    RTS_SOA_BINOP(eq,==,soa_lanes)
+    RTS_SOA_BINOP(ge,>=,soa_lanes)
+    RTS_SOA_BINOP(gt,>,soa_lanes)
+    RTS_SOA_BINOP(ne,!=,soa_lanes)
 
     #undef RTS_SOA_BINOP
+
+    // the vector value of a let binding, the same at every index
+    template <class V, std::size_t N, class A = default_isa>
+    struct soa_value : soa_expr<soa_value<V,N,A>,N,A> {
+      using vector = V;
+      static const int leaves = 0;
+      V value;
+      std::size_t n;
+      RTS_ALWAYS_INLINE constexpr soa_value(const V & value, std::size_t n) noexcept : value(value), n(n) {}
+      RTS_ALWAYS_INLINE RTS_PURE constexpr const vector & vget(int) const noexcept { return value; }
+      RTS_ALWAYS_INLINE RTS_PURE constexpr const vector & vget(int, const vec<bool,A> &) const noexcept { return value; }
+      RTS_ALWAYS_INLINE void prefetch(int) const noexcept {}
+      RTS_ALWAYS_INLINE RTS_PURE std::size_t length() const noexcept { return n; }
+    };
+
+    // f applied to base, with base evaluated once per vector however often f uses it
+    template <class S, class F, std::size_t N, class A = default_isa>
+    struct soa_let : soa_expr<soa_let<S,F,N,A>,N,A> {
+      using bound = soa_value<typename std::decay<decltype(std::declval<const S &>().vget(0))>::type,N,A>;
+      using body = decltype(std::declval<const F &>()(std::declval<bound>()));
+      using vector = typename std::decay<decltype(std::declval<const body &>().vget(0))>::type;
+      static const int leaves = soa_leaves<S>::value + soa_leaves<body>::value;
+      S base;
+      F f;
+      RTS_ALWAYS_INLINE constexpr soa_let(const S & base, const F & f) noexcept : base(base), f(f) {}
+      RTS_ALWAYS_INLINE RTS_PURE vector vget(int i) const noexcept { return f(bound(base.vget(i), base.length())).vget(i); }
+      RTS_ALWAYS_INLINE RTS_PURE vector vget(int i, const vec<bool,A> & mask) const noexcept { return f(bound(base.vget(i, mask), base.length())).vget(i, mask); }
+      RTS_ALWAYS_INLINE void prefetch(int i) const noexcept { base.prefetch(i); f(bound(typename bound::vector(), base.length())).prefetch(i); }
+      RTS_ALWAYS_INLINE RTS_PURE std::size_t length() const noexcept { return base.length(); }
+    };
+
+    // f applied to each vector of base
+    template <class S, class F, std::size_t N, class A = default_isa>
+    struct soa_map : soa_expr<soa_map<S,F,N,A>,N,A> {
+      using vector = typename std::decay<decltype(std::declval<const F &>()(std::declval<const S &>().vget(0)))>::type;
+      static const int leaves = soa_leaves<S>::value;
+      S base;
+      F f;
+      RTS_ALWAYS_INLINE constexpr soa_map(const S & base, const F & f) noexcept : base(base), f(f) {}
+      RTS_ALWAYS_INLINE RTS_PURE vector vget(int i) const noexcept { return f(base.vget(i)); }
+      RTS_ALWAYS_INLINE RTS_PURE vector vget(int i, const vec<bool,A> & mask) const noexcept { return f(base.vget(i, mask)); }
+      RTS_ALWAYS_INLINE void prefetch(int i) const noexcept { base.prefetch(i); }
+      RTS_ALWAYS_INLINE RTS_PURE std::size_t length() const noexcept { return base.length(); }
+    };
+
+    // the first n lanes
+    template <class A>
+    RTS_ALWAYS_INLINE RTS_PURE vec<bool,A> first_lanes(int n) noexcept {
+      vec<bool,A> result(false);
+      for (int i=0;i<n;++i) result.put(i,true);
+      return result;
+    }
+  }
+
+  /// apply @p f, a function from @p vec to @p vec, to each vector of @p e, e.g. @p map(x, [](auto v) { return vec_math::exp(v); })
+  template <class S, std::size_t N, class A, class F>
+  RTS_ALWAYS_INLINE RTS_PURE auto map(const detail::soa_expr<S,N,A> & e, F f) noexcept {
+    return detail::soa_map<detail::soa_operand_t<S>,F,N,A>(e(), f);
+  }
+
+  /// bind @p e for use more than once in @p f, e.g. @p let(x*y, [](auto t) { return t*t + t; }).
+  ///
+  /// @p f receives an expression standing for @p e and returns the expression to evaluate. @p e is evaluated once per vector.
+  /// The result outlives the call to @p f, so a nested @p let must capture the variables of the outer one by value.
+  template <class S, std::size_t N, class A, class F>
+  RTS_ALWAYS_INLINE RTS_PURE auto let(const detail::soa_expr<S,N,A> & e, F f) noexcept {
+    return detail::soa_let<detail::soa_operand_t<S>,F,N,A>(e(), f);
   }
 
   // array of structure of arrays layout
   template <class T, std::size_t N, class A = default_isa>
-  struct alignas(A::alignment) soa : detail::soa_expr<soa<T,N,A>,N,vec<T,A>> {
+  struct alignas(A::alignment) soa : detail::soa_expr<soa<T,N,A>,N,A> {
     using arch = A;
     using vector = vec<T,A>;
     using iterator = typename vector::iterator;;
@@ -103,19 +225,24 @@ namespace rts {
     using const_reference = typename vector::const_reference;
 
     static const std::size_t size = N;
-    static const int vsize = (N+A::mask) >> A::shift;
+    static const int vsize = (N+A::shift_mask) >> A::shift;
     static const int wsize = N >> A::shift;
     vector data[vsize];
 
-    static const bool needs_last = (N & A::mask) != 0;
-    static RTS_PURE vec<bool,A> last_mask() noexcept { return vec<int,A>(N & ~ A::mask, detail::step_tag); }
+    static const bool needs_last = (N & A::shift_mask) != 0;
+    static RTS_PURE vec<bool,A> last_mask() noexcept {
+      vec<bool,A> result(false);
+      for (int i=0;i<int(N & A::shift_mask);++i) result.put(i,true);
+      return result;
+    }
 
     RTS_ALWAYS_INLINE constexpr soa() noexcept {}
     RTS_ALWAYS_INLINE constexpr soa(T t) noexcept {
       vector v(t); // promote to a vector type
       for (auto && r : data) { r = v; } // bulk initialize
     }
-    RTS_ALWAYS_INLINE soa(soa && rhs) noexcept : data(std::move(rhs.data)) {} // move
+    soa(const soa & rhs) = default;
+    soa(soa && rhs) = default;
 
     RTS_ALWAYS_INLINE constexpr soa(T values[N]) noexcept {
       iterator o = begin();
@@ -127,7 +254,7 @@ namespace rts {
     template <typename Base>
     RTS_ALWAYS_INLINE constexpr soa(const detail::soa_expr<Base,N,A> & rhs) noexcept {
       int i = 0;
-      for (;i < (N >> A::shift); ++i)
+      for (;i < wsize; ++i)
         vput(i,rhs.vget(i));
       if (needs_last)
         vput(i,rhs.vget(i,last_mask()));
@@ -142,9 +269,12 @@ namespace rts {
     RTS_ALWAYS_INLINE RTS_CONST constexpr operator pointer() noexcept { return begin(); }
     RTS_ALWAYS_INLINE RTS_CONST constexpr operator const_pointer () const noexcept { return cbegin(); }
     RTS_ALWAYS_INLINE void swap(soa & rhs) noexcept { std::swap(data,rhs.data); }
-    RTS_ALWAYS_INLINE RTS_CONST constexpr vector & vget(int i) const noexcept { return data[i]; }
+    RTS_ALWAYS_INLINE RTS_CONST constexpr const vector & vget(int i) const noexcept { return data[i]; }
     RTS_ALWAYS_INLINE RTS_CONST constexpr const vector & vget(int i, const vec<bool,A> &) const noexcept { return data[i]; }
     RTS_ALWAYS_INLINE void vput(int i, const vector & v) noexcept { data[i] = v; }
+    RTS_ALWAYS_INLINE void vstream(int i, const vector & v) noexcept { stream(data[i], v); }
+    RTS_ALWAYS_INLINE void prefetch(int i) const noexcept { _mm_prefetch(reinterpret_cast<const char *>(data + i), _MM_HINT_T0); }
+    static RTS_ALWAYS_INLINE RTS_CONST constexpr std::size_t length() noexcept { return N; }
     RTS_ALWAYS_INLINE RTS_CONST constexpr auto get(int i) noexcept { return data[i >> A::shift].get(i & A::shift_mask); }
     RTS_ALWAYS_INLINE RTS_CONST constexpr auto get(int i) const noexcept { return data[i >> A::shift].get(i & A::shift_mask); }
     RTS_ALWAYS_INLINE void put(int i, const T & v) noexcept { data[i >> A::shift].put(i & A::shift_mask, v); }
@@ -153,7 +283,7 @@ namespace rts {
       template <typename Base> \
       RTS_ALWAYS_INLINE soa & operator op (const detail::soa_expr<Base,N,A> & rhs) noexcept { \
         int i = 0; \
-        for (;i < (N >> A::shift); ++i) \
+        for (;i < wsize; ++i) \
           data[i] op rhs.vget(i); \
         if (needs_last) \
           data[i] op rhs.vget(i,last_mask()); \
@@ -174,11 +304,8 @@ namespace rts {
 
     #undef RTS_SOA_ASSIGN
 
-    template <typename Base>
-    RTS_ALWAYS_INLINE soa & operator = (soa && rhs) noexcept {
-      for (int i = 0;i < ((N + A :: shift_mask) >> A::shift); ++i)
-        data[i] = std::move(rhs.data[i]);
-    }
+    soa & operator = (const soa & rhs) = default;
+    soa & operator = (soa && rhs) = default;
 
     RTS_ALWAYS_INLINE soa & operator ++ () noexcept {
       for (auto && r : data) ++r;
@@ -206,6 +333,90 @@ namespace rts {
     return v.put(i,u);
   }
 
+  namespace detail {
+    // the loop behind stream_assign, for any destination with vstream
+    template <class D, class Base, std::size_t N, class A>
+    RTS_ALWAYS_INLINE void stream_eval(D & dst, const soa_expr<Base,N,A> & rhs, int wsize, bool needs_last, std::size_t prefetch_distance) noexcept {
+      using vector = typename D::vector;
+      const int line = sizeof(vector) >= 64 ? 1 : int(64 / sizeof(vector)); // vectors per cache line
+      const int ahead = int(std::min<std::size_t>(prefetch_distance / sizeof(vector), std::size_t(wsize)));
+      int i = 0;
+      if (ahead > 0) {
+        for (;i < wsize - ahead; ++i) {
+          if (i % line == 0) rhs.prefetch(i + ahead);
+          dst.vstream(i, rhs.vget(i));
+        }
+      }
+      for (;i < wsize; ++i)
+        dst.vstream(i, rhs.vget(i));
+      if (needs_last)
+        dst.vstream(i, rhs.vget(i, dst.last_mask()));
+      stream_fence();
+    }
+  }
+
+  namespace detail {
+    // K vectors per step, all evaluated before any is stored, so their K independent dependency chains interleave
+    template <int K, class D, class Base, std::size_t N, class A>
+    RTS_ALWAYS_INLINE void unroll_eval(D & dst, const soa_expr<Base,N,A> & rhs, int wsize, bool needs_last) noexcept {
+      using vector = typename D::vector;
+      int i = 0;
+      for (;i + K <= wsize; i += K)
+        index_apply<K>([&](auto... ks) {
+          const vector v[K] = { rhs.vget(i + int(ks))... };
+          RTS_UNUSED auto l = { (dst.vput(i + int(ks), v[ks]), 0)... };
+        });
+      for (;i < wsize; ++i)
+        dst.vput(i, rhs.vget(i));
+      if (needs_last)
+        dst.vput(i, rhs.vget(i, dst.last_mask()));
+    }
+  }
+
+  /// default number of vectors @p unrolled_assign evaluates per step
+  static const int default_unroll = 4;
+
+  /// evaluate @p rhs into @p dst, @p K vectors at a time.
+  ///
+  /// Each step evaluates @p K vectors before storing any of them, so long latency-bound expressions such as
+  /// @p exp and @p log keep @p K independent chains in flight rather than waiting on one.
+  template <int K = default_unroll, class T, std::size_t N, class A, class Base>
+  void unrolled_assign(soa<T,N,A> & dst, const detail::soa_expr<Base,N,A> & rhs) noexcept {
+    static_assert(K > 0, "unroll factor must be positive");
+    detail::unroll_eval<K>(dst, rhs, soa<T,N,A>::wsize, soa<T,N,A>::needs_last);
+  }
+
+  /// evaluate @p rhs into @p dst with non-temporal stores, for results that will not be reread soon.
+  ///
+  /// Each source column is prefetched @p prefetch_distance bytes ahead of the loads, 0 disables prefetching.
+  /// Ends with @p stream_fence, so @p dst may be handed to another thread afterwards.
+  template <class T, std::size_t N, class A, class Base>
+  void stream_assign(soa<T,N,A> & dst, const detail::soa_expr<Base,N,A> & rhs, std::size_t prefetch_distance = default_prefetch_distance) noexcept {
+    detail::stream_eval(dst, rhs, soa<T,N,A>::wsize, soa<T,N,A>::needs_last, prefetch_distance);
+  }
+
+  /// evaluate each of @p rhs into the matching destination of @p dst in one pass, e.g. @p assign(std::tie(a,b), x+y, x-y).
+  ///
+  /// All of the expressions are evaluated for a vector before any result is stored, so the operands and the
+  /// subexpressions they share are loaded and computed once per vector. Every destination has the length of the first.
+  template <class ... Ds, class ... Es, std::size_t N, class A>
+  void assign(const std::tuple<Ds & ...> & dst, const detail::soa_expr<Es,N,A> & ... rhs) noexcept {
+    static_assert(sizeof...(Ds) == sizeof...(Es), "assign needs one expression per destination");
+    auto & first = std::get<0>(dst);
+    const std::size_t n = first.length();
+    const int w = int(n >> A::shift);
+    auto store = [&](int i, const auto & values) {
+      detail::index_apply<sizeof...(Ds)>([&](auto... Is) { RTS_UNUSED auto l = { (std::get<Is>(dst).vput(i, std::get<Is>(values)), 0)... }; });
+    };
+    int i = 0;
+    for (;i < w; ++i)
+      store(i, std::make_tuple(rhs.vget(i)...));
+    if (n & A::shift_mask) {
+      const vec<bool,A> m = first.last_mask();
+      store(i, std::make_tuple(rhs.vget(i, m)...));
+    }
+  }
+
   // ------------------------------------------------------------------------------------
   // Lift <cmath> into soa<>
   // ------------------------------------------------------------------------------------
@@ -214,43 +425,49 @@ namespace rts {
     namespace detail { \
       template <class S, std::size_t N, class A = default_isa> \
       struct soa_unary_math_##fun : public soa_expr<soa_unary_math_##fun<S,N,A>,N,A> { \
-        using vector = decltype(fun(std::declval<typename S::vector>)); \
+        using vector = decltype(std::fun(std::declval<typename S::vector>())); \
+        static const int leaves = soa_leaves<S>::value; \
         S base; \
         RTS_ALWAYS_INLINE constexpr soa_unary_math_##fun(const S & base) noexcept : base(base) {} \
         RTS_ALWAYS_INLINE soa_unary_math_##fun(S && base) noexcept : base(std::move(base)) {} \
-        RTS_ALWAYS_INLINE RTS_MATH_PURE constexpr vector vget(int i) RTS_MATH_NOEXCEPT { return fun(base.vget(i)); } \
-        RTS_ALWAYS_INLINE RTS_MATH_PURE constexpr vector vget(int i, const vec<bool,A> & mask) RTS_MATH_NOEXCEPT { return fun(base.vget(i)); } \
+        RTS_ALWAYS_INLINE RTS_MATH_PURE constexpr vector vget(int i) const RTS_MATH_NOEXCEPT { return std::fun(base.vget(i)); } \
+        RTS_ALWAYS_INLINE RTS_MATH_PURE constexpr vector vget(int i, const vec<bool,A> & mask) const RTS_MATH_NOEXCEPT { return std::fun(base.vget(i, mask)); } \
+        RTS_ALWAYS_INLINE void prefetch(int i) const noexcept { base.prefetch(i); } \
+        RTS_ALWAYS_INLINE RTS_PURE std::size_t length() const noexcept { return base.length(); } \
       }; \
     } \
     template <class S, std::size_t N, class A> \
     RTS_ALWAYS_INLINE RTS_PURE constexpr auto fun(const detail::soa_expr<S,N,A> & base) noexcept { \
-      return detail::soa_unary_math_##fun<S,N,A>(base()); \
+      return detail::soa_unary_math_##fun<detail::soa_operand_t<S>,N,A>(base()); \
     } \
     template <class S, std::size_t N, class A> \
     RTS_ALWAYS_INLINE auto fun(detail::soa_expr<S,N,A> && base) noexcept { \
-      return detail::soa_unary_math_##fun<S,N,A>(std::move(base())); \
+      return detail::soa_unary_math_##fun<detail::soa_operand_t<S>,N,A>(std::move(base())); \
     }
 
   #define RTS_BINARY_MATH(fun) \
     namespace detail { \
       template <class S, class T, std::size_t N, class A = default_isa> \
       struct soa_binary_math_##fun : public soa_expr<soa_binary_math_##fun<S,T,N,A>,N,A> { \
-        using vector = decltype(fun(std::declval<typename S::vector>,std::declval<typename T::vector>)); \
+        using vector = decltype(std::fun(std::declval<typename S::vector>(),std::declval<typename T::vector>())); \
+        static const int leaves = soa_leaves<S>::value + soa_leaves<T>::value; \
         S lhs; \
         T rhs; \
         RTS_ALWAYS_INLINE constexpr soa_binary_math_##fun(const S & lhs, const T & rhs) noexcept : lhs(lhs), rhs(rhs) {} \
         RTS_ALWAYS_INLINE soa_binary_math_##fun(S && lhs, T && rhs) noexcept : lhs(std::move(lhs)), rhs(std::move(rhs)) {} \
-        RTS_ALWAYS_INLINE RTS_MATH_PURE constexpr vector vget(int i) RTS_MATH_NOEXCEPT { return fun(lhs.vget(i),rhs.vget(i)); } \
-        RTS_ALWAYS_INLINE RTS_MATH_PURE constexpr vector vget(int i, const vec<bool,A> & mask) RTS_MATH_NOEXCEPT { return fun(lhs.vget(i, mask),rhs.vget(i, mask)); } \
+        RTS_ALWAYS_INLINE RTS_MATH_PURE constexpr vector vget(int i) const RTS_MATH_NOEXCEPT { return std::fun(lhs.vget(i),rhs.vget(i)); } \
+        RTS_ALWAYS_INLINE RTS_MATH_PURE constexpr vector vget(int i, const vec<bool,A> & mask) const RTS_MATH_NOEXCEPT { return std::fun(lhs.vget(i, mask),rhs.vget(i, mask)); } \
+        RTS_ALWAYS_INLINE void prefetch(int i) const noexcept { lhs.prefetch(i); rhs.prefetch(i); } \
+        RTS_ALWAYS_INLINE RTS_PURE std::size_t length() const noexcept { return lhs.length(); } \
       }; \
     } \
     template <class S, class T, std::size_t N, class A> \
     RTS_ALWAYS_INLINE RTS_PURE constexpr auto fun(const detail::soa_expr<S,N,A> & lhs, const detail::soa_expr<T,N,A> & rhs) noexcept { \
-      return detail::soa_binary_math_##fun<S,T,N,A>(lhs(), rhs()); \
+      return detail::soa_binary_math_##fun<detail::soa_operand_t<S>,detail::soa_operand_t<T>,N,A>(lhs(), rhs()); \
     } \
     template <class S, class T, std::size_t N, class A> \
     RTS_ALWAYS_INLINE auto fun(detail::soa_expr<S,N,A> && lhs, detail::soa_expr<T,N,A> && rhs) noexcept { \
-      return detail::soa_binary_math_##fun<S,T,N,A>(lhs(), rhs()); \
+      return detail::soa_binary_math_##fun<detail::soa_operand_t<S>,detail::soa_operand_t<T>,N,A>(lhs(), rhs()); \
     }
 
   #include "x-math.hpp"
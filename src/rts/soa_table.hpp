@@ -0,0 +1,225 @@
+#pragma once
+
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "soa_vector.hpp"
+
+/// @file rts/soa_table.hpp
+/// @brief multi-field records, stored column-wise or in tiles of @p A::width records
+
+namespace rts {
+  /// storage layouts for @p soa_table
+  namespace layout {
+    /// one aligned column per field
+    struct soa {};
+    /// array of structures of arrays: blocks of @p A::width records, each field a @p vec within the block
+    struct aosoa {};
+  }
+
+  template <class Row, class A = default_isa, class Layout = layout::soa> struct soa_table;
+
+  namespace detail {
+    // field I of every record in a table, usable as an soa expression and assignable from one
+    template <class Table, std::size_t I>
+    struct soa_field : soa_expr<soa_field<Table,I>,dynamic_size,typename std::remove_const<Table>::type::arch> {
+      using table = typename std::remove_const<Table>::type;
+      using arch = typename table::arch;
+      using value_type = typename std::tuple_element<I, typename table::value_type>::type;
+      using vector = vec<value_type,arch>;
+
+      Table & base;
+
+      RTS_ALWAYS_INLINE constexpr soa_field(Table & base) noexcept : base(base) {}
+      RTS_ALWAYS_INLINE constexpr soa_field(const soa_field & rhs) noexcept = default;
+
+      RTS_ALWAYS_INLINE RTS_PURE const vector & vget(int i) const noexcept { return base.template vget_field<I>(i); }
+      RTS_ALWAYS_INLINE RTS_PURE const vector & vget(int i, const vec<bool,arch> &) const noexcept { return base.template vget_field<I>(i); }
+      RTS_ALWAYS_INLINE void prefetch(int i) const noexcept { _mm_prefetch(reinterpret_cast<const char *>(&vget(i)), _MM_HINT_T0); }
+      RTS_ALWAYS_INLINE RTS_PURE auto get(std::size_t i) const noexcept { return vget(int(i >> arch::shift)).get(int(i & arch::shift_mask)); }
+      RTS_ALWAYS_INLINE RTS_PURE std::size_t size() const noexcept { return base.size(); }
+      RTS_ALWAYS_INLINE RTS_PURE std::size_t length() const noexcept { return base.size(); }
+
+      #define RTS_SOA_ASSIGN(op) \
+        template <typename Base> \
+        RTS_ALWAYS_INLINE soa_field & operator op (const soa_expr<Base,dynamic_size,arch> & rhs) noexcept { \
+          int i = 0, w = base.wsize(); \
+          for (;i < w; ++i) \
+            base.template vref_field<I>(i) op rhs.vget(i); \
+          if (base.needs_last()) { \
+            /* lane by lane, so the lanes past size() keep their value and never divide by it */ \
+            auto & v = base.template vref_field<I>(i); \
+            const auto r = rhs.vget(i,base.last_mask()); \
+            for (int l=0, n=int(base.size() & arch::shift_mask);l < n;++l) { \
+              value_type x = v.get(l); \
+              x op r.get(l); \
+              v.put(l, x); \
+            } \
+          } \
+          return *this; \
+        }
+
+      RTS_SOA_ASSIGN(=)
+      RTS_SOA_ASSIGN(+=)
+      RTS_SOA_ASSIGN(-=)
+      RTS_SOA_ASSIGN(*=)
+      RTS_SOA_ASSIGN(/=)
+      RTS_SOA_ASSIGN(%=)
+      RTS_SOA_ASSIGN(<<=)
+      RTS_SOA_ASSIGN(>>=)
+      RTS_SOA_ASSIGN(&=)
+      RTS_SOA_ASSIGN(|=)
+      RTS_SOA_ASSIGN(^=)
+
+      #undef RTS_SOA_ASSIGN
+
+      // assigns the fields, it does not rebind the reference
+      RTS_ALWAYS_INLINE soa_field & operator = (const soa_field & rhs) noexcept {
+        return *this = static_cast<const soa_expr<soa_field,dynamic_size,arch> &>(rhs);
+      }
+    };
+
+    // A::width consecutive records of a table, read and written as a vec<std::tuple<Ts...>,A>
+    template <class Table>
+    struct soa_table_vref {
+      using vector = typename Table::vector;
+      Table & base;
+      int i;
+
+      RTS_ALWAYS_INLINE RTS_PURE operator vector () const noexcept { return base.vget(i); }
+      RTS_ALWAYS_INLINE soa_table_vref & operator = (const vector & v) noexcept { base.vput(i, v); return *this; }
+      RTS_ALWAYS_INLINE soa_table_vref & operator = (const soa_table_vref & v) noexcept { base.vput(i, vector(v)); return *this; }
+    };
+
+    // the parts of the interface shared by every layout
+    template <class Table>
+    struct soa_table_base {
+      RTS_ALWAYS_INLINE RTS_PURE bool empty() const noexcept { return self().size() == 0; }
+      RTS_ALWAYS_INLINE detail::soa_table_vref<Table> vref(int i) noexcept { return { self(), i }; }
+
+      /// field @p I of every record, as an soa expression
+      template <std::size_t I>
+      RTS_ALWAYS_INLINE detail::soa_field<Table,I> field() noexcept { return detail::soa_field<Table,I>(self()); }
+
+      template <std::size_t I>
+      RTS_ALWAYS_INLINE detail::soa_field<const Table,I> field() const noexcept { return detail::soa_field<const Table,I>(self()); }
+
+    private:
+      RTS_ALWAYS_INLINE Table & self() noexcept { return *static_cast<Table*>(this); }
+      RTS_ALWAYS_INLINE const Table & self() const noexcept { return *static_cast<const Table*>(this); }
+    };
+  }
+
+  /// a table of records, one @p soa_vector column per field of the tuple.
+  ///
+  /// @p field<I>() is an soa expression over field @p I, and can be assigned from one.
+  template <class A, class ... Ts>
+  struct soa_table<std::tuple<Ts...>,A,layout::soa> : detail::soa_table_base<soa_table<std::tuple<Ts...>,A,layout::soa>> {
+    static_assert(sizeof...(Ts) > 0, "soa_table needs at least one field");
+
+    using arch = A;
+    using layout_type = layout::soa;
+    using value_type = std::tuple<Ts...>;
+    using vector = vec<value_type,A>;
+    using size_type = std::size_t;
+    using columns_type = std::tuple<soa_vector<Ts,A>...>;
+    static const std::size_t fields = sizeof...(Ts);
+
+    columns_type columns;
+
+  private:
+    template <class F>
+    RTS_ALWAYS_INLINE void each_column(F f) {
+      detail::index_apply<fields>([&](auto... Is) { RTS_UNUSED auto l = { (f(std::get<Is>(columns), Is), 0)... }; });
+    }
+
+  public:
+    RTS_ALWAYS_INLINE soa_table() noexcept = default;
+    explicit soa_table(std::size_t n, const value_type & t = value_type()) { resize(n, t); }
+
+    RTS_ALWAYS_INLINE RTS_PURE std::size_t size() const noexcept { return std::get<0>(columns).size(); }
+    RTS_ALWAYS_INLINE RTS_PURE int vsize() const noexcept { return std::get<0>(columns).vsize(); }
+    RTS_ALWAYS_INLINE RTS_PURE int wsize() const noexcept { return std::get<0>(columns).wsize(); }
+    RTS_ALWAYS_INLINE RTS_PURE bool needs_last() const noexcept { return std::get<0>(columns).needs_last(); }
+    RTS_ALWAYS_INLINE RTS_PURE vec<bool,A> last_mask() const noexcept { return std::get<0>(columns).last_mask(); }
+
+    void reserve(std::size_t n) { each_column([&](auto & c, auto) { c.reserve(n); }); }
+    void resize(std::size_t n, const value_type & t = value_type()) { each_column([&](auto & c, auto I) { c.resize(n, std::get<I>(t)); }); }
+    void clear() noexcept { each_column([&](auto & c, auto) { c.clear(); }); }
+    void push_back(const value_type & t) { each_column([&](auto & c, auto I) { c.push_back(std::get<I>(t)); }); }
+    void push_back(const vector & v) { each_column([&](auto & c, auto I) { c.push_back(std::get<I>(v.data)); }); }
+
+    RTS_ALWAYS_INLINE RTS_PURE value_type get(std::size_t i) const noexcept {
+      return detail::index_apply<fields>([&](auto... Is) { return value_type(std::get<Is>(columns).get(i)...); });
+    }
+
+    RTS_ALWAYS_INLINE void put(std::size_t i, const value_type & t) noexcept { each_column([&](auto & c, auto I) { c.put(i, std::get<I>(t)); }); }
+
+    /// records @p i*A::width up to @p (i+1)*A::width as one vec of tuples
+    RTS_ALWAYS_INLINE RTS_PURE vector vget(int i) const noexcept {
+      vector result;
+      detail::index_apply<fields>([&](auto... Is) { RTS_UNUSED auto l = { (std::get<Is>(result.data) = std::get<Is>(columns).vget(i), 0)... }; });
+      return result;
+    }
+
+    RTS_ALWAYS_INLINE void vput(int i, const vector & v) noexcept { each_column([&](auto & c, auto I) { c.vput(i, std::get<I>(v.data)); }); }
+
+    template <std::size_t I>
+    RTS_ALWAYS_INLINE RTS_PURE const auto & vget_field(int i) const noexcept { return std::get<I>(columns).vget(i); }
+
+    template <std::size_t I>
+    RTS_ALWAYS_INLINE auto & vref_field(int i) noexcept { return std::get<I>(columns).vdata()[i]; }
+  };
+
+  /// a table of records tiled into blocks of @p A::width records, each block a @p vec<std::tuple<Ts...>,A>.
+  ///
+  /// Field expressions evaluate exactly as with @p layout::soa, but all the fields of one record
+  /// share a block, so random access to a record touches one or two cache lines rather than one per field.
+  template <class A, class ... Ts>
+  struct soa_table<std::tuple<Ts...>,A,layout::aosoa> : detail::soa_table_base<soa_table<std::tuple<Ts...>,A,layout::aosoa>> {
+    static_assert(sizeof...(Ts) > 0, "soa_table needs at least one field");
+
+    using arch = A;
+    using layout_type = layout::aosoa;
+    using value_type = std::tuple<Ts...>;
+    using vector = vec<value_type,A>;
+    using size_type = std::size_t;
+    static const std::size_t fields = sizeof...(Ts);
+
+    soa_vector<value_type,A> blocks;
+
+    RTS_ALWAYS_INLINE soa_table() noexcept = default;
+    explicit soa_table(std::size_t n, const value_type & t = value_type()) : blocks(n, t) {}
+
+    RTS_ALWAYS_INLINE RTS_PURE std::size_t size() const noexcept { return blocks.size(); }
+    RTS_ALWAYS_INLINE RTS_PURE int vsize() const noexcept { return blocks.vsize(); }
+    RTS_ALWAYS_INLINE RTS_PURE int wsize() const noexcept { return blocks.wsize(); }
+    RTS_ALWAYS_INLINE RTS_PURE bool needs_last() const noexcept { return blocks.needs_last(); }
+    RTS_ALWAYS_INLINE RTS_PURE vec<bool,A> last_mask() const noexcept { return blocks.last_mask(); }
+
+    void reserve(std::size_t n) { blocks.reserve(n); }
+    void resize(std::size_t n, const value_type & t = value_type()) { blocks.resize(n, t); }
+    void clear() noexcept { blocks.clear(); }
+    void push_back(const value_type & t) { blocks.push_back(t); }
+    void push_back(const vector & v) { blocks.push_back(v); }
+
+    RTS_ALWAYS_INLINE RTS_PURE value_type get(std::size_t i) const noexcept { return blocks.get(i); }
+    RTS_ALWAYS_INLINE void put(std::size_t i, const value_type & t) noexcept { blocks.put(i, t); }
+    RTS_ALWAYS_INLINE RTS_PURE const vector & vget(int i) const noexcept { return blocks.vget(i); }
+    RTS_ALWAYS_INLINE void vput(int i, const vector & v) noexcept { blocks.vput(i, v); }
+
+    template <std::size_t I>
+    RTS_ALWAYS_INLINE RTS_PURE const auto & vget_field(int i) const noexcept { return std::get<I>(blocks.vget(i).data); }
+
+    template <std::size_t I>
+    RTS_ALWAYS_INLINE auto & vref_field(int i) noexcept { return std::get<I>(blocks.vdata()[i].data); }
+  };
+
+  /// field @p I of every record of @p t
+  template <std::size_t I, class Row, class A, class Layout>
+  RTS_ALWAYS_INLINE auto field(soa_table<Row,A,Layout> & t) noexcept { return t.template field<I>(); }
+
+  template <std::size_t I, class Row, class A, class Layout>
+  RTS_ALWAYS_INLINE auto field(const soa_table<Row,A,Layout> & t) noexcept { return t.template field<I>(); }
+}
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "aligned.hpp"
+#include "soa.hpp"
+
+/// @file rts/soa_vector.hpp
+/// @brief a growable structure of arrays with a runtime length
+
+namespace rts {
+  template <class T, class A = default_isa> struct soa_vector;
+
+  namespace detail {
+    template <class T, class A> struct soa_operand<soa_vector<T,A>> { using type = soa_ref<soa_vector<T,A>,dynamic_size,A>; };
+  }
+
+  /// a single column of @p T, stored as an @p A::alignment aligned heap array of @p vec<T,A>.
+  ///
+  /// Expressions combine @p soa_vector operands of the same length; this is not checked.
+  /// Lanes past @p size() in the last vector hold @p T() until a plain assignment writes unspecified values there;
+  /// compound assignments leave them alone.
+  template <class T, class A>
+  struct soa_vector : detail::soa_expr<soa_vector<T,A>,dynamic_size,A> {
+    using arch = A;
+    using vector = vec<T,A>;
+    using value_type = T;
+    using size_type = std::size_t;
+    using iterator = typename vector::iterator;
+    using const_iterator = typename vector::const_iterator;
+    using pointer = typename vector::pointer;
+    using const_pointer = typename vector::const_pointer;
+    using reference = typename vector::reference;
+    using const_reference = typename vector::const_reference;
+
+    static const std::size_t alignment = alignof(vector) > std::size_t(A::alignment) ? alignof(vector) : std::size_t(A::alignment);
+
+  private:
+    vector * data_;
+    std::size_t size_;     // in elements
+    std::size_t capacity_; // in vectors
+
+    static vector * allocate(std::size_t n) {
+      vector * p = static_cast<vector *>(aligned_allocate(n * sizeof(vector), alignment));
+      for (std::size_t i=0;i<n;++i) new (p + i) vector();
+      return p;
+    }
+
+    static void deallocate(vector * p, std::size_t n) noexcept {
+      if (p == nullptr) return;
+      for (std::size_t i=0;i<n;++i) p[i].~vector();
+      aligned_deallocate(p);
+    }
+
+    // grow to hold at least n vectors, doubling for amortized O(1) push_back
+    void grow(std::size_t n) {
+      if (n <= capacity_) return;
+      std::size_t c = std::max(n, 2 * capacity_);
+      vector * p = allocate(c);
+      for (std::size_t i=0, e = vsize();i<e;++i) p[i] = std::move(data_[i]);
+      deallocate(data_, capacity_);
+      data_ = p;
+      capacity_ = c;
+    }
+
+  public:
+    RTS_ALWAYS_INLINE soa_vector() noexcept : data_(nullptr), size_(0), capacity_(0) {}
+
+    explicit soa_vector(std::size_t n, const T & t = T()) : data_(nullptr), size_(0), capacity_(0) {
+      resize(n, t);
+    }
+
+    soa_vector(const T * values, std::size_t n) : data_(nullptr), size_(0), capacity_(0) {
+      reserve(n);
+      for (std::size_t i=0;i<n;++i) push_back(values[i]);
+    }
+
+    /// evaluate an expression over @p n lanes
+    template <typename Base>
+    soa_vector(std::size_t n, const detail::soa_expr<Base,dynamic_size,A> & rhs) : data_(nullptr), size_(0), capacity_(0) {
+      resize(n);
+      *this = rhs;
+    }
+
+    soa_vector(const soa_vector & rhs) : data_(nullptr), size_(0), capacity_(0) {
+      grow(rhs.vsize());
+      size_ = rhs.size_;
+      std::copy(rhs.data_, rhs.data_ + rhs.vsize(), data_);
+    }
+
+    RTS_ALWAYS_INLINE soa_vector(soa_vector && rhs) noexcept : data_(rhs.data_), size_(rhs.size_), capacity_(rhs.capacity_) {
+      rhs.data_ = nullptr;
+      rhs.size_ = rhs.capacity_ = 0;
+    }
+
+    ~soa_vector() noexcept { deallocate(data_, capacity_); }
+
+    soa_vector & operator = (const soa_vector & rhs) {
+      if (this != &rhs) {
+        soa_vector t(rhs);
+        swap(t);
+      }
+      return *this;
+    }
+
+    RTS_ALWAYS_INLINE soa_vector & operator = (soa_vector && rhs) noexcept {
+      swap(rhs);
+      return *this;
+    }
+
+    RTS_ALWAYS_INLINE void swap(soa_vector & rhs) noexcept {
+      std::swap(data_,rhs.data_);
+      std::swap(size_,rhs.size_);
+      std::swap(capacity_,rhs.capacity_);
+    }
+
+    RTS_ALWAYS_INLINE RTS_PURE std::size_t size() const noexcept { return size_; }
+    RTS_ALWAYS_INLINE RTS_PURE bool empty() const noexcept { return size_ == 0; }
+    RTS_ALWAYS_INLINE RTS_PURE std::size_t length() const noexcept { return size_; }
+    RTS_ALWAYS_INLINE RTS_PURE std::size_t capacity() const noexcept { return capacity_ << A::shift; }
+    RTS_ALWAYS_INLINE RTS_PURE int vsize() const noexcept { return int((size_ + A::shift_mask) >> A::shift); }
+    RTS_ALWAYS_INLINE RTS_PURE int wsize() const noexcept { return int(size_ >> A::shift); }
+    RTS_ALWAYS_INLINE RTS_PURE bool needs_last() const noexcept { return (size_ & A::shift_mask) != 0; }
+
+    RTS_ALWAYS_INLINE RTS_PURE vec<bool,A> last_mask() const noexcept { return detail::first_lanes<A>(int(size_ & A::shift_mask)); }
+
+    void reserve(std::size_t n) { grow((n + A::shift_mask) >> A::shift); }
+
+    void resize(std::size_t n, const T & t = T()) {
+      const std::size_t vn = (n + A::shift_mask) >> A::shift;
+      grow(vn);
+      std::size_t i = size_;
+      for (;i<n && (i & A::shift_mask);++i) put(i,t);
+      for (const vector v(t);i + A::width <= n;i += A::width) data_[i >> A::shift] = v;
+      for (;i<n;++i) put(i,t);
+      for (i=n;i<(vn << A::shift);++i) put(i,T()); // keep the tail lanes clean
+      size_ = n;
+    }
+
+    RTS_ALWAYS_INLINE void clear() noexcept { resize(0); }
+
+    void push_back(const T & t) {
+      if (size_ == (capacity_ << A::shift)) grow(capacity_ + 1);
+      put(size_++, t);
+    }
+
+    /// append all @p A::width lanes of @p v
+    void push_back(const vector & v) {
+      grow(((size_ + A::shift_mask) >> A::shift) + 1);
+      if ((size_ & A::shift_mask) == 0)
+        data_[size_ >> A::shift] = v;
+      else
+        for (int i=0;i<A::width;++i) put(size_ + i, v.get(i));
+      size_ += A::width;
+    }
+
+    RTS_ALWAYS_INLINE RTS_CONST iterator begin() noexcept { return data_ ? data_->begin() : iterator(); }
+    RTS_ALWAYS_INLINE RTS_CONST iterator end() noexcept { return begin() + size_; }
+    RTS_ALWAYS_INLINE RTS_CONST const_iterator begin() const noexcept { return cbegin(); }
+    RTS_ALWAYS_INLINE RTS_CONST const_iterator end() const noexcept { return cend(); }
+    RTS_ALWAYS_INLINE RTS_CONST const_iterator cbegin() const noexcept { return data_ ? data_->cbegin() : const_iterator(); }
+    RTS_ALWAYS_INLINE RTS_CONST const_iterator cend() const noexcept { return cbegin() + size_; }
+
+    RTS_ALWAYS_INLINE RTS_CONST vector * vdata() noexcept { return data_; }
+    RTS_ALWAYS_INLINE RTS_CONST const vector * vdata() const noexcept { return data_; }
+    RTS_ALWAYS_INLINE RTS_CONST const vector & vget(int i) const noexcept { return data_[i]; }
+    RTS_ALWAYS_INLINE RTS_CONST const vector & vget(int i, const vec<bool,A> &) const noexcept { return data_[i]; }
+    RTS_ALWAYS_INLINE void vput(int i, const vector & v) noexcept { data_[i] = v; }
+    RTS_ALWAYS_INLINE void vstream(int i, const vector & v) noexcept { stream(data_[i], v); }
+    RTS_ALWAYS_INLINE void prefetch(int i) const noexcept { _mm_prefetch(reinterpret_cast<const char *>(data_ + i), _MM_HINT_T0); }
+    RTS_ALWAYS_INLINE RTS_PURE auto get(std::size_t i) const noexcept { return data_[i >> A::shift].get(int(i & A::shift_mask)); }
+    RTS_ALWAYS_INLINE void put(std::size_t i, const T & v) noexcept { data_[i >> A::shift].put(int(i & A::shift_mask), v); }
+
+    #define RTS_SOA_ASSIGN(op) \
+      template <typename Base> \
+      RTS_ALWAYS_INLINE soa_vector & operator op (const detail::soa_expr<Base,dynamic_size,A> & rhs) noexcept { \
+        int i = 0, w = wsize(); \
+        for (;i < w; ++i) \
+          data_[i] op rhs.vget(i); \
+        if (needs_last()) { \
+          /* lane by lane, so the lanes past size() keep T() and never divide by it */ \
+          const auto r = rhs.vget(i,last_mask()); \
+          for (int l=0, n=int(size_ & A::shift_mask);l < n;++l) { \
+            T x = data_[i].get(l); \
+            x op r.get(l); \
+            data_[i].put(l, x); \
+          } \
+        } \
+        return *this; \
+      }
+
+    RTS_SOA_ASSIGN(=)
+    RTS_SOA_ASSIGN(+=)
+    RTS_SOA_ASSIGN(-=)
+    RTS_SOA_ASSIGN(*=)
+    RTS_SOA_ASSIGN(/=)
+    RTS_SOA_ASSIGN(%=)
+    RTS_SOA_ASSIGN(<<=)
+    RTS_SOA_ASSIGN(>>=)
+    RTS_SOA_ASSIGN(&=)
+    RTS_SOA_ASSIGN(|=)
+    RTS_SOA_ASSIGN(^=)
+
+    #undef RTS_SOA_ASSIGN
+  };
+
+  /// @p stream_assign for @p soa_vector
+  template <class T, class A, class Base>
+  void stream_assign(soa_vector<T,A> & dst, const detail::soa_expr<Base,dynamic_size,A> & rhs, std::size_t prefetch_distance = default_prefetch_distance) noexcept {
+    detail::stream_eval(dst, rhs, dst.wsize(), dst.needs_last(), prefetch_distance);
+  }
+
+  namespace detail {
+    // tiles of `tile` vectors, with the operands of the next tile prefetched a cache line at a time during this one
+    template <class D, class Base, std::size_t N, class A>
+    void blocked_eval(D & dst, const soa_expr<Base,N,A> & rhs, int wsize, bool needs_last, int tile) noexcept {
+      using vector = typename D::vector;
+      const int line = std::max(1, int(system_caches().line / sizeof(vector))); // vectors per cache line
+      const int vsize = wsize + (needs_last ? 1 : 0);
+      for (int t = 0; t < wsize; t += tile) {
+        const int end = std::min(t + tile, wsize);
+        for (int i = t; i < end; ++i) {
+          if ((i - t) % line == 0 && i + tile < vsize) rhs.prefetch(i + tile);
+          dst.vput(i, rhs.vget(i));
+        }
+      }
+      if (needs_last)
+        dst.vput(wsize, rhs.vget(wsize, dst.last_mask()));
+    }
+  }
+
+  /// the number of vectors per tile @p blocked_assign uses for an expression of type @p E producing @p vector:
+  /// half the l1d shared between the operands and the destination, leaving the other half for the tile being prefetched.
+  template <class E, class vector = typename std::decay<decltype(std::declval<const E &>().vget(0))>::type>
+  RTS_PURE int default_tile() noexcept {
+    const cache_sizes & caches = system_caches();
+    const std::size_t line = std::max<std::size_t>(1, caches.line / sizeof(vector));
+    const std::size_t columns = std::size_t(detail::soa_leaves<E>::value) + 1;
+    const std::size_t tile = caches.l1d / 2 / columns / sizeof(vector) / line * line;
+    return int(std::max(tile, line));
+  }
+
+  /// evaluate @p rhs into @p dst in tiles of @p tile vectors, 0 picks @p default_tile.
+  ///
+  /// While a tile is evaluated the operands of the next are prefetched, so expressions over many large
+  /// columns work from l1 rather than waiting on memory one column at a time.
+  template <class T, class A, class Base>
+  void blocked_assign(soa_vector<T,A> & dst, const detail::soa_expr<Base,dynamic_size,A> & rhs, int tile = 0) noexcept {
+    detail::blocked_eval(dst, rhs, dst.wsize(), dst.needs_last(), tile > 0 ? tile : default_tile<Base>());
+  }
+
+  /// @p unrolled_assign for @p soa_vector
+  template <int K = default_unroll, class T, class A, class Base>
+  void unrolled_assign(soa_vector<T,A> & dst, const detail::soa_expr<Base,dynamic_size,A> & rhs) noexcept {
+    static_assert(K > 0, "unroll factor must be positive");
+    detail::unroll_eval<K>(dst, rhs, dst.wsize(), dst.needs_last());
+  }
+}
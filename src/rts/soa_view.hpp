@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include "soa.hpp"
+#include "soa_vector.hpp"
+
+/// @file rts/soa_view.hpp
+/// @brief lazy selections and permutations of soa containers
+
+namespace rts {
+  namespace detail {
+    // the elements of a container whose vectors are plain arrays of its values
+    template <class S>
+    RTS_ALWAYS_INLINE const typename S::value_type * view_base(const S & source) noexcept {
+      using T = typename S::value_type;
+      static_assert(sizeof(typename S::vector) == sizeof(T) * S::arch::width, "soa_view needs vec<T,A> to be laid out as a plain array of T");
+      return source.length() ? reinterpret_cast<const T *>(&source.vget(0)) : nullptr;
+    }
+  }
+
+  /// the elements of a container at the positions given by an int32 index expression, gathered a vector at a time.
+  ///
+  /// The view is an expression of the same length as its index, so it feeds assignments and reductions without a copy
+  /// of the selected rows. Like any expression it refers to its container, and to a container used as the index, so
+  /// both must outlive it. @p view rejects a temporary source or a temporary container index at compile time, but
+  /// nothing stops a named container from being destroyed or resized while a view of it is still in use.
+  template <class T, class I, std::size_t N, class A = default_isa>
+  struct soa_view : detail::soa_expr<soa_view<T,I,N,A>,N,A> {
+    using arch = A;
+    using vector = vec<T,A>;
+    using value_type = T;
+    using pointers = vec<based_ptr<T>,A>;
+    static const int leaves = detail::soa_leaves<I>::value + 1;
+
+    T * base;
+    I index;
+
+    RTS_ALWAYS_INLINE constexpr soa_view(const T * base, const I & index) noexcept : base(const_cast<T *>(base)), index(index) {}
+
+    RTS_ALWAYS_INLINE RTS_PURE vector vget(int i) const noexcept { return load(pointers(base, index.vget(i))); }
+    // lanes outside the mask may hold any index, so they are never dereferenced
+    RTS_ALWAYS_INLINE RTS_PURE vector vget(int i, const vec<bool,A> & mask) const noexcept { return load(pointers(base, index.vget(i, mask)), mask); }
+    // the gathered rows are wherever the index says, so only the index is worth fetching ahead
+    RTS_ALWAYS_INLINE void prefetch(int i) const noexcept { index.prefetch(i); }
+    RTS_ALWAYS_INLINE RTS_PURE std::size_t length() const noexcept { return index.length(); }
+  };
+
+  /// the elements of @p source, a container of plain @p float or @p int32_t vectors such as @p soa_vector, at the positions in
+  /// @p index, e.g. @p sum(view(x, order) * w) with @p order = argsort(y). Views compose through their index: @p view(x, view(p, q)).
+  template <class S, class I, std::size_t N, class A>
+  RTS_ALWAYS_INLINE RTS_PURE auto view(const S & source, const detail::soa_expr<I,N,A> & index) noexcept {
+    static_assert(std::is_same<typename S::arch, A>::value, "view: the source and index must share an arch");
+    static_assert(std::is_same<typename std::decay<decltype(index.vget(0))>::type, vec<std::int32_t,A>>::value, "view: the index must be an int32 expression");
+    return soa_view<typename S::value_type,detail::soa_operand_t<I>,N,A>(detail::view_base(source), index());
+  }
+
+  /// a view points into its source, so a temporary one would be gone before the view is read
+  template <class S, class I, std::size_t N, class A, typename std::enable_if<!std::is_lvalue_reference<S>::value, int>::type = 0>
+  void view(S && source, const detail::soa_expr<I,N,A> & index) = delete;
+
+  /// a view holds a container index by reference, so a temporary one would be gone before the view is read
+  template <class S, class T, class A>
+  void view(const S & source, soa_vector<T,A> && index) = delete;
+
+  template <class S, class T, std::size_t N, class A>
+  void view(const S & source, soa<T,N,A> && index) = delete;
+}
@@ -0,0 +1,448 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "soa_vector.hpp"
+#include "vec.hpp"
+
+/// @file rts/sort.hpp
+/// @brief sorting soa columns with in-register sorting networks
+///
+/// On avx2_8 float and int32 columns are sorted 64 at a time entirely in registers, then merged pairwise with
+/// a bitonic merge of two registers per eight outputs. Other arches and element types fall back to @p std::sort
+/// over the column's storage. NaN keys sort after every other key: they are moved to the end before the rest is sorted,
+/// as the min/max compare-exchanges of the networks would duplicate one operand of a NaN pair and drop the other.
+
+namespace rts {
+  namespace detail {
+  #ifdef __AVX2__
+    namespace sorting {
+      using A8 = target::avx2_8;
+      template <class K> using keys = vec<K,A8>;
+      template <class K> using pairs = vec<std::pair<K,std::int32_t>,A8>;
+
+      RTS_ALWAYS_INLINE RTS_CONST __m256i lanes(int a, int b, int c, int d, int e, int f, int g, int h) noexcept {
+        return _mm256_setr_epi32(a,b,c,d,e,f,g,h);
+      }
+
+      RTS_ALWAYS_INLINE keys<float> load(const float * p) noexcept { return keys<float>(_mm256_loadu_ps(p), internal_tag); }
+      RTS_ALWAYS_INLINE keys<std::int32_t> load(const std::int32_t * p) noexcept { return keys<std::int32_t>(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)), internal_tag); }
+      RTS_ALWAYS_INLINE void store(float * p, const keys<float> & x) noexcept { _mm256_storeu_ps(p, x.m); }
+      RTS_ALWAYS_INLINE void store(std::int32_t * p, const keys<std::int32_t> & x) noexcept { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), x.m); }
+
+      RTS_ALWAYS_INLINE RTS_PURE keys<float> permute(const keys<float> & x, __m256i idx) noexcept { return keys<float>(_mm256_permutevar8x32_ps(x.m, idx), internal_tag); }
+      RTS_ALWAYS_INLINE RTS_PURE keys<std::int32_t> permute(const keys<std::int32_t> & x, __m256i idx) noexcept { return keys<std::int32_t>(_mm256_permutevar8x32_epi32(x.m, idx), internal_tag); }
+
+      // all ones in the lanes where a < b
+      RTS_ALWAYS_INLINE RTS_PURE __m256i less(const keys<float> & a, const keys<float> & b) noexcept { return _mm256_castps_si256(_mm256_cmp_ps(a.m, b.m, _CMP_LT_OQ)); }
+      RTS_ALWAYS_INLINE RTS_PURE __m256i less(const keys<std::int32_t> & a, const keys<std::int32_t> & b) noexcept { return _mm256_cmpgt_epi32(b.m, a.m); }
+
+      // b in the lanes set in m, a elsewhere
+      RTS_ALWAYS_INLINE RTS_PURE keys<float> select(const keys<float> & a, const keys<float> & b, __m256i m) noexcept { return keys<float>(_mm256_blendv_ps(a.m, b.m, _mm256_castsi256_ps(m)), internal_tag); }
+      RTS_ALWAYS_INLINE RTS_PURE keys<std::int32_t> select(const keys<std::int32_t> & a, const keys<std::int32_t> & b, __m256i m) noexcept { return keys<std::int32_t>(_mm256_blendv_epi8(a.m, b.m, m), internal_tag); }
+
+      template <class K>
+      RTS_ALWAYS_INLINE void minmax(keys<K> & a, keys<K> & b) noexcept {
+        keys<K> t = vec_intrinsics::min(a, b);
+        b = vec_intrinsics::max(a, b);
+        a = t;
+      }
+
+      // compare each lane with lane idx[i], keeping the lesser where upper is clear and the greater where it is set
+      template <class K>
+      RTS_ALWAYS_INLINE RTS_PURE keys<K> step(const keys<K> & x, __m256i idx, __m256i upper) noexcept {
+        keys<K> p = permute(x, idx);
+        return select(vec_intrinsics::min(x, p), vec_intrinsics::max(x, p), upper);
+      }
+
+      template <class K>
+      RTS_ALWAYS_INLINE pairs<K> load(const K * k, const std::int32_t * v) noexcept {
+        pairs<K> r;
+        r.first = load(k);
+        r.second = load(v);
+        return r;
+      }
+
+      template <class K>
+      RTS_ALWAYS_INLINE void store(K * k, std::int32_t * v, const pairs<K> & x) noexcept {
+        store(k, x.first);
+        store(v, x.second);
+      }
+
+      template <class K>
+      RTS_ALWAYS_INLINE RTS_PURE pairs<K> permute(const pairs<K> & x, __m256i idx) noexcept {
+        pairs<K> r;
+        r.first = permute(x.first, idx);
+        r.second = permute(x.second, idx);
+        return r;
+      }
+
+      template <class K>
+      RTS_ALWAYS_INLINE RTS_PURE pairs<K> select(const pairs<K> & a, const pairs<K> & b, __m256i m) noexcept {
+        pairs<K> r;
+        r.first = select(a.first, b.first, m);
+        r.second = select(a.second, b.second, m);
+        return r;
+      }
+
+      template <class K>
+      RTS_ALWAYS_INLINE void minmax(pairs<K> & a, pairs<K> & b) noexcept {
+        const __m256i m = less(b.first, a.first);
+        pairs<K> t = select(a, b, m);
+        b = select(b, a, m);
+        a = t;
+      }
+
+      // ties keep their own lane on both sides of each pair, so no value is lost or duplicated
+      template <class K>
+      RTS_ALWAYS_INLINE RTS_PURE pairs<K> step(const pairs<K> & x, __m256i idx, __m256i upper) noexcept {
+        pairs<K> p = permute(x, idx);
+        const __m256i take = _mm256_or_si256(
+          _mm256_andnot_si256(upper, less(p.first, x.first)),
+          _mm256_and_si256(upper, less(x.first, p.first))
+        );
+        return select(x, p, take);
+      }
+
+      // sort the lanes of a bitonic register
+      template <class R>
+      RTS_ALWAYS_INLINE RTS_PURE R clean(R x) noexcept {
+        x = step(x, lanes(4,5,6,7,0,1,2,3), lanes(0,0,0,0,-1,-1,-1,-1));
+        x = step(x, lanes(2,3,0,1,6,7,4,5), lanes(0,0,-1,-1,0,0,-1,-1));
+        return step(x, lanes(1,0,3,2,5,4,7,6), lanes(0,-1,0,-1,0,-1,0,-1));
+      }
+
+      // sort the lanes of any register
+      template <class R>
+      RTS_ALWAYS_INLINE RTS_PURE R sort(R x) noexcept {
+        x = step(x, lanes(1,0,3,2,5,4,7,6), lanes(0,-1,0,-1,0,-1,0,-1));
+        x = step(x, lanes(3,2,1,0,7,6,5,4), lanes(0,0,-1,-1,0,0,-1,-1));
+        x = step(x, lanes(1,0,3,2,5,4,7,6), lanes(0,-1,0,-1,0,-1,0,-1));
+        x = step(x, lanes(7,6,5,4,3,2,1,0), lanes(0,0,0,0,-1,-1,-1,-1));
+        x = step(x, lanes(2,3,0,1,6,7,4,5), lanes(0,0,-1,-1,0,0,-1,-1));
+        return step(x, lanes(1,0,3,2,5,4,7,6), lanes(0,-1,0,-1,0,-1,0,-1));
+      }
+
+      // given sorted a and b, leave the least 8 of their lanes in a and the greatest 8 in b, both sorted
+      template <class R>
+      RTS_ALWAYS_INLINE void merge(R & a, R & b) noexcept {
+        b = permute(b, lanes(7,6,5,4,3,2,1,0));
+        minmax(a, b);
+        a = clean(a);
+        b = clean(b);
+      }
+
+      // sort the bitonic sequence spread across x[0,K)
+      template <class R>
+      RTS_ALWAYS_INLINE void clean(R * x, std::integral_constant<int,1>) noexcept { x[0] = clean(x[0]); }
+
+      template <class R, int K>
+      RTS_ALWAYS_INLINE void clean(R * x, std::integral_constant<int,K>) noexcept {
+        for (int i=0;i<K/2;++i) minmax(x[i], x[i+K/2]);
+        clean(x, std::integral_constant<int,K/2>());
+        clean(x + K/2, std::integral_constant<int,K/2>());
+      }
+
+      // merge the sorted runs x[0,K) and x[K,2K) in registers
+      template <int K, class R>
+      RTS_ALWAYS_INLINE void merge(R * x) noexcept {
+        for (int i=0;i<K/2;++i) std::swap(x[K+i], x[2*K-1-i]);
+        for (int i=0;i<K;++i) {
+          x[K+i] = permute(x[K+i], lanes(7,6,5,4,3,2,1,0));
+          minmax(x[i], x[K+i]);
+        }
+        clean(x, std::integral_constant<int,K>());
+        clean(x + K, std::integral_constant<int,K>());
+      }
+
+      RTS_ALWAYS_INLINE void transpose(__m256 r[8]) noexcept {
+        __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]), t1 = _mm256_unpackhi_ps(r[0], r[1]);
+        __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]), t3 = _mm256_unpackhi_ps(r[2], r[3]);
+        __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]), t5 = _mm256_unpackhi_ps(r[4], r[5]);
+        __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]), t7 = _mm256_unpackhi_ps(r[6], r[7]);
+        __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1,0,1,0)), s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3,2,3,2));
+        __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1,0,1,0)), s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3,2,3,2));
+        __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1,0,1,0)), s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3,2,3,2));
+        __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1,0,1,0)), s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3,2,3,2));
+        r[0] = _mm256_permute2f128_ps(s0, s4, 0x20); r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+        r[1] = _mm256_permute2f128_ps(s1, s5, 0x20); r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+        r[2] = _mm256_permute2f128_ps(s2, s6, 0x20); r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+        r[3] = _mm256_permute2f128_ps(s3, s7, 0x20); r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+      }
+
+      RTS_ALWAYS_INLINE void transpose(keys<float> r[8]) noexcept {
+        __m256 t[8];
+        for (int i=0;i<8;++i) t[i] = r[i].m;
+        transpose(t);
+        for (int i=0;i<8;++i) r[i].m = t[i];
+      }
+
+      RTS_ALWAYS_INLINE void transpose(keys<std::int32_t> r[8]) noexcept {
+        __m256 t[8];
+        for (int i=0;i<8;++i) t[i] = _mm256_castsi256_ps(r[i].m);
+        transpose(t);
+        for (int i=0;i<8;++i) r[i].m = _mm256_castps_si256(t[i]);
+      }
+
+      template <class K>
+      RTS_ALWAYS_INLINE void transpose(pairs<K> r[8]) noexcept {
+        keys<K> k[8];
+        keys<std::int32_t> v[8];
+        for (int i=0;i<8;++i) { k[i] = r[i].first; v[i] = r[i].second; }
+        transpose(k);
+        transpose(v);
+        for (int i=0;i<8;++i) { r[i].first = k[i]; r[i].second = v[i]; }
+      }
+
+      // sort 64 keys held in r: an optimal 19 comparator network down the columns, a transpose to turn the
+      // columns into sorted runs of 8, then bitonic merges up to a single run
+      template <class R>
+      RTS_ALWAYS_INLINE void sort64(R r[8]) noexcept {
+        minmax(r[0],r[2]); minmax(r[1],r[3]); minmax(r[4],r[6]); minmax(r[5],r[7]);
+        minmax(r[0],r[4]); minmax(r[1],r[5]); minmax(r[2],r[6]); minmax(r[3],r[7]);
+        minmax(r[0],r[1]); minmax(r[2],r[3]); minmax(r[4],r[5]); minmax(r[6],r[7]);
+        minmax(r[2],r[4]); minmax(r[3],r[5]);
+        minmax(r[1],r[4]); minmax(r[3],r[6]);
+        minmax(r[1],r[2]); minmax(r[3],r[4]); minmax(r[5],r[6]);
+        transpose(r);
+        merge(r[0], r[1]); merge(r[2], r[3]); merge(r[4], r[5]); merge(r[6], r[7]);
+        merge<2>(r); merge<2>(r + 4);
+        merge<4>(r);
+      }
+
+      // a run of keys
+      template <class K>
+      struct key_run {
+        using reg = keys<K>;
+        K * k;
+        struct spill {
+          K k[8];
+          RTS_ALWAYS_INLINE key_run run() noexcept { return key_run{k}; }
+        };
+        RTS_ALWAYS_INLINE reg load(std::size_t i) const noexcept { return sorting::load(k + i); }
+        RTS_ALWAYS_INLINE void store(std::size_t i, const reg & r) const noexcept { sorting::store(k + i, r); }
+        RTS_ALWAYS_INLINE const K & key(std::size_t i) const noexcept { return k[i]; }
+        RTS_ALWAYS_INLINE void put(std::size_t i, const key_run & src, std::size_t j) const noexcept { k[i] = src.k[j]; }
+        RTS_ALWAYS_INLINE void swap(std::size_t i, std::size_t j) const noexcept { std::swap(k[i], k[j]); }
+        RTS_ALWAYS_INLINE key_run operator + (std::size_t o) const noexcept { return key_run{k + o}; }
+      };
+
+      // a run of keys, each carrying an int32 payload
+      template <class K>
+      struct pair_run {
+        using reg = pairs<K>;
+        K * k;
+        std::int32_t * v;
+        struct spill {
+          K k[8];
+          std::int32_t v[8];
+          RTS_ALWAYS_INLINE pair_run run() noexcept { return pair_run{k, v}; }
+        };
+        RTS_ALWAYS_INLINE reg load(std::size_t i) const noexcept { return sorting::load(k + i, v + i); }
+        RTS_ALWAYS_INLINE void store(std::size_t i, const reg & r) const noexcept { sorting::store(k + i, v + i, r); }
+        RTS_ALWAYS_INLINE const K & key(std::size_t i) const noexcept { return k[i]; }
+        RTS_ALWAYS_INLINE void put(std::size_t i, const pair_run & src, std::size_t j) const noexcept { k[i] = src.k[j]; v[i] = src.v[j]; }
+        RTS_ALWAYS_INLINE void swap(std::size_t i, std::size_t j) const noexcept { std::swap(k[i], k[j]); std::swap(v[i], v[j]); }
+        RTS_ALWAYS_INLINE pair_run operator + (std::size_t o) const noexcept { return pair_run{k + o, v + o}; }
+      };
+
+      // merge sorted a[0,na) and b[0,nb) into out. eight outputs per step while both sides have a whole register left.
+      template <class Run>
+      void merge_runs(const Run & a, std::size_t na, const Run & b, std::size_t nb, const Run & out) noexcept {
+        std::size_t i = 0, j = 0, o = 0, h = 0, nh = 0;
+        typename Run::spill s;
+        const Run sr = s.run();
+        if (na >= 8 && nb >= 8) {
+          typename Run::reg lo = a.load(0), hi = b.load(0);
+          i = j = 8;
+          merge(lo, hi);
+          out.store(0, lo);
+          o = 8;
+          while (i + 8 <= na && j + 8 <= nb) {
+            if (a.key(i) < b.key(j)) { lo = a.load(i); i += 8; }
+            else { lo = b.load(j); j += 8; }
+            merge(lo, hi);
+            out.store(o, lo);
+            o += 8;
+          }
+          sr.store(0, hi);
+          nh = 8;
+        }
+        // what is left of the three sorted sequences
+        while (h < nh || i < na || j < nb) {
+          if (h < nh && (i >= na || !(a.key(i) < sr.key(h))) && (j >= nb || !(b.key(j) < sr.key(h)))) out.put(o++, sr, h++);
+          else if (i < na && (j >= nb || !(b.key(j) < a.key(i)))) out.put(o++, a, i++);
+          else out.put(o++, b, j++);
+        }
+      }
+
+      // sort data[0,n), using scratch[0,n) as the other half of each merge pass
+      template <class Run>
+      void merge_sort(const Run & data, const Run & scratch, std::size_t n) noexcept {
+        const std::size_t full = n & ~std::size_t(63);
+        for (std::size_t b=0;b<full;b+=64) {
+          typename Run::reg r[8];
+          for (int i=0;i<8;++i) r[i] = data.load(b + std::size_t(i) * 8);
+          sort64(r);
+          for (int i=0;i<8;++i) data.store(b + std::size_t(i) * 8, r[i]);
+        }
+        for (std::size_t i=full+1;i<n;++i)
+          for (std::size_t j=i;j>full && data.key(j) < data.key(j-1);--j)
+            data.swap(j, j-1);
+
+        Run src = data, dst = scratch;
+        for (std::size_t w=64;w<n;w*=2) {
+          for (std::size_t lo=0;lo<n;lo+=2*w) {
+            const std::size_t mid = std::min(lo + w, n), hi = std::min(lo + 2*w, n);
+            merge_runs(src + lo, mid - lo, src + mid, hi - mid, dst + lo);
+          }
+          std::swap(src, dst);
+        }
+        if (src.k != data.k)
+          for (std::size_t i=0;i<n;++i) data.put(i, src, i);
+      }
+    }
+  #endif
+
+    template <class T, class A> struct simd_sortable : std::false_type {};
+  #ifdef __AVX2__
+    template <> struct simd_sortable<float,target::avx2_8> : std::true_type {};
+    template <> struct simd_sortable<std::int32_t,target::avx2_8> : std::true_type {};
+  #endif
+
+    template <class T, class A>
+    RTS_ALWAYS_INLINE T * column_data(soa_vector<T,A> & x) noexcept {
+      static_assert(sizeof(vec<T,A>) == sizeof(T) * A::width, "sorting needs vec<T,A> to be laid out as a plain array of T");
+      return reinterpret_cast<T *>(x.vdata());
+    }
+
+    template <class T, class A>
+    RTS_ALWAYS_INLINE const T * column_data(const soa_vector<T,A> & x) noexcept {
+      static_assert(sizeof(vec<T,A>) == sizeof(T) * A::width, "sorting needs vec<T,A> to be laid out as a plain array of T");
+      return reinterpret_cast<const T *>(x.vdata());
+    }
+
+    // <, with NaN after everything else
+    struct sort_less {
+      template <class T> RTS_ALWAYS_INLINE RTS_PURE bool operator () (const T & a, const T & b) const noexcept { return a < b || (b != b && a == a); }
+    };
+
+    template <class T>
+    RTS_ALWAYS_INLINE RTS_PURE bool is_nan(const T & t) noexcept { return t != t; }
+
+    // move the NaNs of p[0,n) to the end, returning how many keys are left in front of them
+    template <class T>
+    std::size_t nans_last(T * p, std::size_t n) {
+      if (!std::is_floating_point<T>::value) return n;
+      return std::size_t(std::partition(p, p + n, [](const T & t) { return !is_nan(t); }) - p);
+    }
+
+    // the same for the indices out[0,n) into p, keeping the NaN ones in their original order
+    template <class T>
+    std::size_t nans_last(const T * p, std::int32_t * out, std::size_t n) {
+      if (!std::is_floating_point<T>::value) return n;
+      return std::size_t(std::stable_partition(out, out + n, [p](std::int32_t i) { return !is_nan(p[i]); }) - out);
+    }
+
+    template <class T>
+    void sort_values(T * p, std::size_t n, std::false_type) {
+      std::sort(p, p + n);
+    }
+
+    // sort the indices out[0,n) by the keys they pick from p
+    template <class T>
+    void argsort_values(const T * p, std::int32_t * out, std::size_t n, std::false_type) {
+      std::sort(out, out + n, [p](std::int32_t a, std::int32_t b) { return p[a] < p[b]; });
+    }
+
+  #ifdef __AVX2__
+    template <class T>
+    void sort_values(T * p, std::size_t n, std::true_type) {
+      std::vector<T> scratch(n);
+      sorting::merge_sort(sorting::key_run<T>{p}, sorting::key_run<T>{scratch.data()}, n);
+    }
+
+    template <class T>
+    void argsort_values(const T * p, std::int32_t * out, std::size_t n, std::true_type) {
+      std::vector<T> k(n), sk(n);
+      std::vector<std::int32_t> sv(n);
+      for (std::size_t i=0;i<n;++i) k[i] = p[out[i]];
+      sorting::merge_sort(sorting::pair_run<T>{k.data(), out}, sorting::pair_run<T>{sk.data(), sv.data()}, n);
+    }
+  #endif
+  }
+
+  /// the lanes of @p x in ascending order
+  template <class T, class A>
+  RTS_ALWAYS_INLINE RTS_PURE vec<T,A> sort_lanes(vec<T,A> x) noexcept {
+    T t[A::width];
+    for (int i=0;i<A::width;++i) t[i] = x.get(i);
+    std::sort(t, t + A::width, detail::sort_less());
+    for (int i=0;i<A::width;++i) x.put(i, t[i]);
+    return x;
+  }
+
+  /// the lanes of @p x in ascending order of their keys, each value moving with its key
+  template <class K, class A>
+  RTS_ALWAYS_INLINE RTS_PURE vec<std::pair<K,std::int32_t>,A> sort_lanes(vec<std::pair<K,std::int32_t>,A> x) noexcept {
+    std::pair<K,std::int32_t> t[A::width];
+    for (int i=0;i<A::width;++i) t[i] = x.get(i);
+    std::sort(t, t + A::width, [](const std::pair<K,std::int32_t> & a, const std::pair<K,std::int32_t> & b) { return detail::sort_less()(a.first, b.first); });
+    for (int i=0;i<A::width;++i) x.put(i, t[i]);
+    return x;
+  }
+
+#ifdef __AVX2__
+  // the networks lose NaN lanes, so registers holding any take the scalar path
+  RTS_ALWAYS_INLINE RTS_PURE vec<float,target::avx2_8> sort_lanes(vec<float,target::avx2_8> x) noexcept {
+    if (_mm256_movemask_ps(_mm256_cmp_ps(x.m, x.m, _CMP_UNORD_Q))) return sort_lanes<float,target::avx2_8>(x);
+    return detail::sorting::sort(x);
+  }
+  RTS_ALWAYS_INLINE RTS_PURE vec<std::int32_t,target::avx2_8> sort_lanes(vec<std::int32_t,target::avx2_8> x) noexcept { return detail::sorting::sort(x); }
+  RTS_ALWAYS_INLINE RTS_PURE vec<std::pair<float,std::int32_t>,target::avx2_8> sort_lanes(vec<std::pair<float,std::int32_t>,target::avx2_8> x) noexcept {
+    if (_mm256_movemask_ps(_mm256_cmp_ps(x.first.m, x.first.m, _CMP_UNORD_Q))) return sort_lanes<float,target::avx2_8>(x);
+    return detail::sorting::sort(x);
+  }
+  RTS_ALWAYS_INLINE RTS_PURE vec<std::pair<std::int32_t,std::int32_t>,target::avx2_8> sort_lanes(vec<std::pair<std::int32_t,std::int32_t>,target::avx2_8> x) noexcept { return detail::sorting::sort(x); }
+
+  /// merge the ascending runs @p a[0,na) and @p b[0,nb) into @p out[0,na+nb). neither may hold NaN
+  template <class T>
+  void merge_sorted(const T * a, std::size_t na, const T * b, std::size_t nb, T * out) noexcept {
+    static_assert(detail::simd_sortable<T,target::avx2_8>::value, "merge_sorted needs float or int32 keys");
+    using run = detail::sorting::key_run<T>;
+    detail::sorting::merge_runs(run{const_cast<T *>(a)}, na, run{const_cast<T *>(b)}, nb, run{out});
+  }
+#else
+  /// merge the ascending runs @p a[0,na) and @p b[0,nb) into @p out[0,na+nb). neither may hold NaN
+  template <class T>
+  void merge_sorted(const T * a, std::size_t na, const T * b, std::size_t nb, T * out) {
+    std::merge(a, a + na, b, b + nb, out);
+  }
+#endif
+
+  /// sort @p x ascending, in place, with any NaNs last
+  template <class T, class A>
+  void sort(soa_vector<T,A> & x) {
+    T * p = detail::column_data(x);
+    detail::sort_values(p, detail::nans_last(p, x.size()), detail::simd_sortable<T,A>());
+  }
+
+  /// the permutation that sorts @p x: @p x[result[0]] <= @p x[result[1]] <= ... The order of equal keys is unspecified.
+  /// the indices of NaN keys come last, in ascending order.
+  template <class T, class A>
+  soa_vector<std::int32_t,A> argsort(const soa_vector<T,A> & x) {
+    soa_vector<std::int32_t,A> result(x.size());
+    if (!x.empty()) {
+      const T * p = detail::column_data(x);
+      std::int32_t * out = detail::column_data(result);
+      std::iota(out, out + x.size(), 0);
+      detail::argsort_values(p, out, detail::nans_last(p, out, x.size()), detail::simd_sortable<T,A>());
+    }
+    return result;
+  }
+}
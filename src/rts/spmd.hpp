@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include "varying.hpp"
+
+/// @file rts/spmd.hpp
+/// @brief SPMD control flow with the execution mask in an explicit context
+///
+/// The @p if_ and @p while_ of varying.hpp keep the mask in @p thread_local storage, which every masked assignment
+/// reads and every divergent branch writes. A @p spmd_context carries the same masks as a plain local object instead.
+/// Threaded by reference through kernels that inline, it never leaves registers. Assignments go through the context:
+/// @p ctx.assign(y, x * 2.f) where the thread_local design writes @p y = x * 2.f.
+
+namespace rts {
+  /// the execution mask of an SPMD kernel, and the lanes that have left the innermost loop through @p break_ or
+  /// @p continue_
+  template <class A = default_isa>
+  struct spmd_context {
+    using arch = A;
+    using mask_type = vec<bool,A>;
+
+    mask_type mask, continued, broken, exited;
+
+    RTS_ALWAYS_INLINE spmd_context() noexcept : mask(true), continued(false), broken(false), exited(false) {}
+    RTS_ALWAYS_INLINE explicit spmd_context(const mask_type & mask) noexcept : mask(mask), continued(false), broken(false), exited(false) {}
+
+    /// write @p src to the active lanes of @p dst
+    template <class T>
+    RTS_ALWAYS_INLINE void assign(varying<T,A> & dst, const varying<T,A> & src) const noexcept {
+      dst.data = detail::blend(mask, src.data, dst.data);
+    }
+
+    template <class T>
+    RTS_ALWAYS_INLINE void assign(varying<T,A> & dst, const typename varying<T,A>::value_type & src) const noexcept {
+      dst.data = detail::blend(mask, vec<T,A>(src), dst.data);
+    }
+
+    /// run @p t on the active lanes where @p v is set, leaving the mask alone when they agree
+    template <class T>
+    RTS_ALWAYS_INLINE void if_(const mask_type & v, T t) {
+      const std::uint32_t live = movemask(mask);
+      const std::uint32_t taken = movemask(mask & v);
+      if (taken == 0) return;
+      if (taken == live) { t(); return; }
+      const mask_type entry = mask;
+      mask &= v;
+      t();
+      mask = entry & ~exited;
+    }
+
+    /// run @p t on the active lanes where @p v is set and @p f on the rest
+    template <class T, class F>
+    RTS_ALWAYS_INLINE void if_(const mask_type & v, T t, F f) {
+      const std::uint32_t live = movemask(mask);
+      const std::uint32_t taken = movemask(mask & v);
+      if (taken == live) { if (live) t(); return; }
+      if (taken == 0) { f(); return; }
+      const mask_type entry = mask;
+      mask &= v;
+      t();
+      mask = entry & ~v & ~exited;
+      f();
+      mask = entry & ~exited;
+    }
+
+    template <class T>
+    RTS_ALWAYS_INLINE void if_(const varying<bool,A> & v, T t) { if_(v.data, t); }
+
+    template <class T, class F>
+    RTS_ALWAYS_INLINE void if_(const varying<bool,A> & v, T t, F f) { if_(v.data, t, f); }
+
+    /// run @p body while any lane's varying @p cond holds, as @p rts::while_
+    template <class C, class B>
+    RTS_ALWAYS_INLINE void while_(C cond, B body) {
+      const mask_type entry = mask, outer_broken = broken, outer_continued = continued;
+      broken = false;
+      continued = false;
+      while (any(mask &= detail::mask_of(cond()))) {
+        body();
+        next();
+      }
+      leave(entry, outer_broken, outer_continued);
+    }
+
+    /// @p init, then @p while_(cond, body) with @p step after the body, as @p rts::for_
+    template <class I, class C, class S, class B>
+    RTS_ALWAYS_INLINE void for_(I init, C cond, S step, B body) {
+      init();
+      const mask_type entry = mask, outer_broken = broken, outer_continued = continued;
+      broken = false;
+      continued = false;
+      while (any(mask &= detail::mask_of(cond()))) {
+        body();
+        next();
+        step();
+      }
+      leave(entry, outer_broken, outer_continued);
+    }
+
+    /// switch the active lanes off until the end of the innermost loop
+    RTS_ALWAYS_INLINE void break_() noexcept {
+      broken |= mask;
+      exited |= mask;
+      mask = false;
+    }
+
+    /// switch the active lanes off until the end of the current iteration of the innermost loop
+    RTS_ALWAYS_INLINE void continue_() noexcept {
+      continued |= mask;
+      exited |= mask;
+      mask = false;
+    }
+
+    /// @p rts::foreach over [lo,hi) under this context, with every lane on for each full step
+    template <class F>
+    RTS_ALWAYS_INLINE void foreach(std::int32_t lo, std::int32_t hi, F f) {
+      using ivec = vec<std::int32_t,A>;
+      if (hi <= lo) return;
+      const ivec lanes = detail::lane_indices<A>();
+      const std::int32_t full = hi - ((hi - lo) & std::int32_t(A::shift_mask));
+      const mask_type entry = mask, outer_continued = continued, outer_broken = broken, outer_exited = exited;
+      std::int32_t i = lo;
+      for (;i < full;i += A::width) {
+        step(mask_type(true));
+        f(varying<std::int32_t,A>(lanes + ivec(i)));
+      }
+      if (i < hi) {
+        step(lanes < ivec(hi - i));
+        f(varying<std::int32_t,A>(lanes + ivec(i)));
+      }
+      mask = entry;
+      continued = outer_continued;
+      broken = outer_broken;
+      exited = outer_exited;
+    }
+
+  private:
+    RTS_ALWAYS_INLINE void next() noexcept {
+      mask |= continued;
+      exited &= ~continued;
+      continued = false;
+    }
+
+    RTS_ALWAYS_INLINE void leave(const mask_type & entry, const mask_type & outer_broken, const mask_type & outer_continued) noexcept {
+      mask = entry;
+      exited &= ~(broken | continued);
+      exited |= outer_broken | outer_continued;
+      broken = outer_broken;
+      continued = outer_continued;
+    }
+
+    RTS_ALWAYS_INLINE void step(const mask_type & m) noexcept {
+      mask = m;
+      continued = false;
+      exited = false;
+    }
+  };
+}
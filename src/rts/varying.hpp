@@ -1,12 +1,76 @@
+#pragma once
+
+#include <limits>
+#include <type_traits>
+#include <utility>
 #include "vec.hpp"
 
+/// @file rts/varying.hpp
+/// @brief SPMD style values and control flow
+///
+/// A @p varying holds one value per program instance, a lane of a @p vec. Control flow over varying conditions narrows
+/// the thread's @p execution_mask rather than branching per lane, and assignment to a varying only writes the lanes
+/// that are still running.
 
 namespace rts {
+  /// the lanes running the current SPMD code
   template <class A = default_isa>
   thread_local vec<bool,A> execution_mask = true;
 
+  namespace detail {
+    // lanes that left the innermost loop iteration, the innermost loop, or the function body through continue_, break_ or return_
+    template <class A> thread_local vec<bool,A> continued_lanes = false;
+    template <class A> thread_local vec<bool,A> broken_lanes = false;
+    template <class A> thread_local vec<bool,A> returned_lanes = false;
+    // the union of the three above, which every narrowing of the mask has to keep switched off when it widens again
+    template <class A> thread_local vec<bool,A> exited_lanes = false;
+
+    // t where m is set, f elsewhere
+    template <class T, class A>
+    RTS_ALWAYS_INLINE RTS_PURE vec<T,A> blend(const vec<bool,A> & m, const vec<T,A> & t, const vec<T,A> & f) noexcept {
+      vec<T,A> result(f);
+      foreach_active(m, [&](int i) { result.put(i, t.get(i)); });
+      return result;
+    }
+
+    template <class A>
+    RTS_ALWAYS_INLINE RTS_PURE vec<bool,A> blend(const vec<bool,A> & m, const vec<bool,A> & t, const vec<bool,A> & f) noexcept {
+      return (m & t) | (~m & f);
+    }
+
+  #ifdef __AVX__
+    RTS_ALWAYS_INLINE RTS_PURE vec<float,target::avx_8> blend(const vec<bool,target::avx_8> & m, const vec<float,target::avx_8> & t, const vec<float,target::avx_8> & f) noexcept {
+      return vec<float,target::avx_8>(_mm256_blendv_ps(f.m, t.m, _mm256_castsi256_ps(m.m)), detail::internal_tag);
+    }
+
+    RTS_ALWAYS_INLINE RTS_PURE vec<std::int32_t,target::avx_8> blend(const vec<bool,target::avx_8> & m, const vec<std::int32_t,target::avx_8> & t, const vec<std::int32_t,target::avx_8> & f) noexcept {
+      return vec<std::int32_t,target::avx_8>(_mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(f.m), _mm256_castsi256_ps(t.m), _mm256_castsi256_ps(m.m))), detail::internal_tag);
+    }
+
+    RTS_ALWAYS_INLINE RTS_PURE vec<float,target::avx_4> blend(const vec<bool,target::avx_4> & m, const vec<float,target::avx_4> & t, const vec<float,target::avx_4> & f) noexcept {
+      return vec<float,target::avx_4>(_mm_blendv_ps(f.m, t.m, _mm_castsi128_ps(m.m)), detail::internal_tag);
+    }
+
+    RTS_ALWAYS_INLINE RTS_PURE vec<std::int32_t,target::avx_4> blend(const vec<bool,target::avx_4> & m, const vec<std::int32_t,target::avx_4> & t, const vec<std::int32_t,target::avx_4> & f) noexcept {
+      return vec<std::int32_t,target::avx_4>(_mm_blendv_epi8(f.m, t.m, m.m), detail::internal_tag);
+    }
+  #endif
+
+  #ifdef __AVX2__
+    RTS_ALWAYS_INLINE RTS_PURE vec<float,target::avx2_8> blend(const vec<bool,target::avx2_8> & m, const vec<float,target::avx2_8> & t, const vec<float,target::avx2_8> & f) noexcept {
+      return vec<float,target::avx2_8>(_mm256_blendv_ps(f.m, t.m, _mm256_castsi256_ps(m.m)), detail::internal_tag);
+    }
+
+    RTS_ALWAYS_INLINE RTS_PURE vec<std::int32_t,target::avx2_8> blend(const vec<bool,target::avx2_8> & m, const vec<std::int32_t,target::avx2_8> & t, const vec<std::int32_t,target::avx2_8> & f) noexcept {
+      return vec<std::int32_t,target::avx2_8>(_mm256_blendv_epi8(f.m, t.m, m.m), detail::internal_tag);
+    }
+  #endif
+  }
+
   template <class T, class A = default_isa>
   struct varying {
+    using arch = A;
+    using value_type = T;
     using vector = vec<T, A>;
 
     using iterator = typename vector::iterator;
@@ -20,15 +84,33 @@ namespace rts {
 
     RTS_ALWAYS_INLINE constexpr varying() noexcept(std::is_nothrow_default_constructible<vector>::value) : data() {}
 
-    template <typename ... Args>
-    RTS_ALWAYS_INLINE constexpr varying(Args && ... args) noexcept(noexcept(vector(std::forward(args)...))) : data(std::forward(args)...) {}
+    template <typename ... Args, typename = typename std::enable_if<std::is_constructible<vector, Args && ...>::value>::type>
+    RTS_ALWAYS_INLINE constexpr varying(Args && ... args) noexcept(noexcept(vector(std::forward<Args>(args)...))) : data(std::forward<Args>(args)...) {}
 
     explicit RTS_ALWAYS_INLINE varying(const vector & data) noexcept(std::is_nothrow_copy_constructible<vector>::value) : data(data) {}
     explicit RTS_ALWAYS_INLINE varying(vector && data) noexcept(std::is_nothrow_move_constructible<vector>::value) : data(std::move(data)) {}
 
-    RTS_ALWAYS_INLINE varying(varying && rhs) : data(std::move(rhs.data)) {}
+    RTS_ALWAYS_INLINE varying(const varying & rhs) = default;
+    RTS_ALWAYS_INLINE varying(varying && rhs) = default;
+
+    // assignment only writes the lanes in the execution mask
+    RTS_ALWAYS_INLINE varying & operator = (const varying & rhs) noexcept {
+      data = detail::blend(execution_mask<A>, rhs.data, data);
+      return *this;
+    }
+
+    RTS_ALWAYS_INLINE varying & operator = (const vector & rhs) noexcept {
+      data = detail::blend(execution_mask<A>, rhs, data);
+      return *this;
+    }
+
+    RTS_ALWAYS_INLINE varying & operator = (const T & rhs) noexcept {
+      data = detail::blend(execution_mask<A>, vector(rhs), data);
+      return *this;
+    }
 
-    template <typename U>
+    // loads the active lanes from anything indexable, e.g. a pointer
+    template <typename U, typename = typename std::enable_if<!std::is_convertible<U, vector>::value>::type>
     RTS_ALWAYS_INLINE varying & operator = (U rhs) noexcept {
         load(data,rhs,execution_mask<A>);
         return *this;
@@ -47,7 +129,7 @@ namespace rts {
     RTS_ALWAYS_INLINE void put(int i, const T & rhs) noexcept { data.put(i,rhs); }
     RTS_ALWAYS_INLINE RTS_CONST RTS_MUTABLE_CONSTEXPR operator vec<T,A> & () & { return data; }
     RTS_ALWAYS_INLINE RTS_CONST constexpr operator const vec<T,A> & () const & { return data; }
-    RTS_ALWAYS_INLINE RTS_CONST operator vec<T,A> && () && { return data; }
+    RTS_ALWAYS_INLINE RTS_CONST operator vec<T,A> && () && { return std::move(data); }
   };
 
   template <size_t i, class T, class A>
@@ -66,6 +148,61 @@ namespace rts {
     return varying<T,A>(std::move(v));
   }
 
+  #define RTS_VARYING_UNOP(op) \
+    template <class T, class A> \
+    RTS_ALWAYS_INLINE RTS_PURE auto operator op (const varying<T,A> & v) noexcept { \
+      return make_varying(op v.data); \
+    }
+
+  // a uniform operand is broadcast to every lane
+  #define RTS_VARYING_BINOP(op) \
+    template <class T, class A> \
+    RTS_ALWAYS_INLINE RTS_PURE auto operator op (const varying<T,A> & l, const varying<T,A> & r) noexcept { \
+      return make_varying(l.data op r.data); \
+    } \
+    template <class T, class A> \
+    RTS_ALWAYS_INLINE RTS_PURE auto operator op (const varying<T,A> & l, const typename varying<T,A>::value_type & r) noexcept { \
+      return make_varying(l.data op vec<T,A>(r)); \
+    } \
+    template <class T, class A> \
+    RTS_ALWAYS_INLINE RTS_PURE auto operator op (const typename varying<T,A>::value_type & l, const varying<T,A> & r) noexcept { \
+      return make_varying(vec<T,A>(l) op r.data); \
+    }
+
+  #define RTS_VARYING_ASSIGN(op) \
+    template <class T, class A, class U> \
+    RTS_ALWAYS_INLINE varying<T,A> & operator op##= (varying<T,A> & l, const U & r) noexcept { \
+      return l = l op r; \
+    }
+
+  RTS_VARYING_UNOP(-)
+  RTS_VARYING_UNOP(~)
+  RTS_VARYING_UNOP(!)
+  RTS_VARYING_BINOP(+)
+  RTS_VARYING_BINOP(-)
+  RTS_VARYING_BINOP(*)
+  RTS_VARYING_BINOP(/)
+  RTS_VARYING_BINOP(&)
+  RTS_VARYING_BINOP(|)
+  RTS_VARYING_BINOP(^)
+  RTS_VARYING_BINOP(==)
+  RTS_VARYING_BINOP(!=)
+  RTS_VARYING_BINOP(<)
+  RTS_VARYING_BINOP(<=)
+  RTS_VARYING_BINOP(>)
+  RTS_VARYING_BINOP(>=)
+  RTS_VARYING_ASSIGN(+)
+  RTS_VARYING_ASSIGN(-)
+  RTS_VARYING_ASSIGN(*)
+  RTS_VARYING_ASSIGN(/)
+  RTS_VARYING_ASSIGN(&)
+  RTS_VARYING_ASSIGN(|)
+  RTS_VARYING_ASSIGN(^)
+
+  #undef RTS_VARYING_UNOP
+  #undef RTS_VARYING_BINOP
+  #undef RTS_VARYING_ASSIGN
+
   #define RTS_UNARY_MATH(fun) \
     template <class T, class A> \
     RTS_ALWAYS_INLINE RTS_MATH_PURE constexpr auto fun(const varying<T,A> & v) RTS_MATH_NOEXCEPT { \
@@ -75,7 +212,7 @@ namespace rts {
   #define RTS_BINARY_MATH(fun) \
     template <class U, class V, class A> \
     RTS_ALWAYS_INLINE RTS_MATH_PURE constexpr auto fun(const varying<U,A> & u, const varying<V,A> & v) RTS_MATH_NOEXCEPT { \
-      return make_varying(fun(vec<U,A>(v), vec<V,A>(v))); \
+      return make_varying(fun(vec<U,A>(u), vec<V,A>(v))); \
     }
 
   #include "x-math.hpp"
@@ -84,6 +221,16 @@ namespace rts {
   #undef RTS_BINARY_MATH
 
   namespace detail {
+    template <class A>
+    RTS_ALWAYS_INLINE RTS_PURE const vec<bool,A> & mask_of(const vec<bool,A> & m) noexcept { return m; }
+
+    template <class A>
+    RTS_ALWAYS_INLINE RTS_PURE const vec<bool,A> & mask_of(const varying<bool,A> & m) noexcept { return m.data; }
+
+    // the arch of the mask returned by a loop condition
+    template <class C>
+    using condition_arch = typename std::decay<decltype(mask_of(std::declval<C &>()()))>::type::arch;
+
     template <class A>
     struct execution_mask_scope {
       vec<bool,A> old_mask;
@@ -91,24 +238,169 @@ namespace rts {
       RTS_ALWAYS_INLINE execution_mask_scope() noexcept : old_mask(execution_mask<A>) {}
       execution_mask_scope(const execution_mask_scope & other) = delete;
       execution_mask_scope(execution_mask_scope && other) = delete;
-      RTS_ALWAYS_INLINE ~execution_mask_scope() noexcept { execution_mask<A> = old_mask; }
+      // lanes that left through break_, continue_ or return_ stay off
+      RTS_ALWAYS_INLINE ~execution_mask_scope() noexcept { execution_mask<A> = old_mask & ~exited_lanes<A>; }
     };
+
+    // a loop collects its own break_ and continue_ lanes, and gives back the ones of any loop it is nested in on exit
+    template <class A>
+    struct loop_scope {
+      vec<bool,A> entry, outer_broken, outer_continued;
+
+      RTS_ALWAYS_INLINE loop_scope() noexcept : entry(execution_mask<A>), outer_broken(broken_lanes<A>), outer_continued(continued_lanes<A>) {
+        broken_lanes<A> = false;
+        continued_lanes<A> = false;
+      }
+      loop_scope(const loop_scope & other) = delete;
+      loop_scope(loop_scope && other) = delete;
+
+      // lanes that continued rejoin at the end of each iteration
+      RTS_ALWAYS_INLINE void next() noexcept {
+        execution_mask<A> |= continued_lanes<A>;
+        exited_lanes<A> &= ~continued_lanes<A>;
+        continued_lanes<A> = false;
+      }
+
+      // everything that entered the loop leaves it, except lanes that returned
+      RTS_ALWAYS_INLINE ~loop_scope() noexcept {
+        execution_mask<A> = entry & ~returned_lanes<A>;
+        exited_lanes<A> &= ~(broken_lanes<A> | continued_lanes<A>);
+        exited_lanes<A> |= outer_broken | outer_continued;
+        broken_lanes<A> = outer_broken;
+        continued_lanes<A> = outer_continued;
+      }
+    };
+
+    // the body of function_, which contains its return_ lanes, and break_ or continue_ lanes as well
+    template <class A>
+    struct function_scope {
+      vec<bool,A> entry, outer_returned, outer_broken, outer_continued, outer_exited;
+
+      RTS_ALWAYS_INLINE function_scope() noexcept
+      : entry(execution_mask<A>), outer_returned(returned_lanes<A>), outer_broken(broken_lanes<A>)
+      , outer_continued(continued_lanes<A>), outer_exited(exited_lanes<A>) {
+        returned_lanes<A> = false;
+        broken_lanes<A> = false;
+        continued_lanes<A> = false;
+      }
+      function_scope(const function_scope & other) = delete;
+      function_scope(function_scope && other) = delete;
+
+      RTS_ALWAYS_INLINE ~function_scope() noexcept {
+        execution_mask<A> = entry;
+        returned_lanes<A> = outer_returned;
+        broken_lanes<A> = outer_broken;
+        continued_lanes<A> = outer_continued;
+        exited_lanes<A> = outer_exited;
+      }
+    };
+
+    template <class A>
+    RTS_ALWAYS_INLINE void exit_lanes(vec<bool,A> & into) noexcept {
+      into |= execution_mask<A>;
+      exited_lanes<A> |= execution_mask<A>;
+      execution_mask<A> = false;
+    }
   }
 
+  /// run every lane again, forgetting any lanes that were switched off, e.g. at the start of a task
+  template <class A = default_isa>
+  RTS_ALWAYS_INLINE void reset_execution_mask() noexcept {
+    execution_mask<A> = true;
+    detail::continued_lanes<A> = false;
+    detail::broken_lanes<A> = false;
+    detail::returned_lanes<A> = false;
+    detail::exited_lanes<A> = false;
+  }
+
+  namespace detail {
+    // the branches of an if_ whose condition splits the active lanes, each run under its own part of the mask
+    template <class T, class A>
+    RTS_ALWAYS_INLINE void divergent_if(const vec<bool,A> & v, T & t) {
+      execution_mask_scope<A> scope;
+      execution_mask<A> &= v;
+      t();
+    }
+
+    template <class T, class F, class A>
+    RTS_ALWAYS_INLINE void divergent_if(const vec<bool,A> & v, T & t, F & f) {
+      execution_mask_scope<A> scope;
+      execution_mask<A> &= v;
+      t();
+      // t may have switched lanes off, so the else branch starts again from the mask on entry
+      execution_mask<A> = scope.old_mask & ~v & ~exited_lanes<A>;
+      f();
+    }
+  }
+
+  /// run @p t on the active lanes where @p v is set. when those are all of the active lanes, or none of them, the mask
+  /// is left alone and @p t runs or is skipped outright
   template <class T, class A>
   RTS_ALWAYS_INLINE void if_(const vec<bool,A> & v, T t) noexcept(noexcept(t())) {
-    detail::execution_mask_scope<A> scope;
-    if (any(execution_mask<A> &= v))
-      t();
+    const std::uint32_t live = movemask(execution_mask<A>);
+    const std::uint32_t taken = movemask(execution_mask<A> & v);
+    if (taken == 0) return;
+    if (taken == live) t();
+    else detail::divergent_if(v, t);
   }
 
+  /// run @p t on the active lanes where @p v is set and @p f on the rest
   template <class T, class F, class A>
   RTS_ALWAYS_INLINE void if_(const vec<bool,A> & v, T t, F f) noexcept(noexcept(t()) && noexcept(f())) {
-    detail::execution_mask_scope<A> scope;
-    if (any(execution_mask<A> &= v))
-      t();
-    if (any(execution_mask<A> = ~execution_mask<A> & scope.old_mask))
-      f();
+    const std::uint32_t live = movemask(execution_mask<A>);
+    const std::uint32_t taken = movemask(execution_mask<A> & v);
+    if (taken == live) { if (live) t(); }
+    else if (taken == 0) f();
+    else detail::divergent_if(v, t, f);
+  }
+
+  template <class T, class A>
+  RTS_ALWAYS_INLINE void if_(const varying<bool,A> & v, T t) noexcept(noexcept(t())) {
+    if_(v.data, t);
+  }
+
+  template <class T, class F, class A>
+  RTS_ALWAYS_INLINE void if_(const varying<bool,A> & v, T t, F f) noexcept(noexcept(t()) && noexcept(f())) {
+    if_(v.data, t, f);
+  }
+
+  /// a coherent if: @p if_ for conditions expected to agree across the active lanes, with the coherent cases laid out as
+  /// the fall through. the divergent case stays inline, as moving it out of line makes the captured varyings escape.
+  template <class T, class A>
+  RTS_ALWAYS_INLINE void cif_(const vec<bool,A> & v, T t) {
+    const std::uint32_t live = movemask(execution_mask<A>);
+    const std::uint32_t taken = movemask(execution_mask<A> & v);
+    if (RTS_LIKELY(taken == live)) { if (live) t(); }
+    else if (RTS_LIKELY(taken != 0)) detail::divergent_if(v, t);
+  }
+
+  template <class T, class F, class A>
+  RTS_ALWAYS_INLINE void cif_(const vec<bool,A> & v, T t, F f) {
+    const std::uint32_t live = movemask(execution_mask<A>);
+    const std::uint32_t taken = movemask(execution_mask<A> & v);
+    if (RTS_LIKELY(taken == live)) { if (live) t(); }
+    else if (RTS_LIKELY(taken == 0)) f();
+    else detail::divergent_if(v, t, f);
+  }
+
+  template <class T, class A>
+  RTS_ALWAYS_INLINE void cif_(const varying<bool,A> & v, T t) {
+    cif_(v.data, t);
+  }
+
+  template <class T, class F, class A>
+  RTS_ALWAYS_INLINE void cif_(const varying<bool,A> & v, T t, F f) {
+    cif_(v.data, t, f);
+  }
+
+  template <class T>
+  RTS_ALWAYS_INLINE void cif_(bool v, T t) {
+    if (v) t();
+  }
+
+  template <class T, class F>
+  RTS_ALWAYS_INLINE void cif_(bool v, T t, F f) {
+    if (v) t(); else f();
   }
 
   template <class T>
@@ -120,8 +412,247 @@ namespace rts {
   RTS_ALWAYS_INLINE void if_(bool v, T t, F f) noexcept(noexcept(t()) && noexcept(f())) {
     if (v) t(); else f();
   }
+
+  /// run @p body while any lane's varying @p cond holds. each lane leaves when its own condition fails, the loop ends
+  /// once no lane is left, e.g. @p while_([&]{ return abs(f(x)) > eps; }, [&]{ x -= f(x) / df(x); })
+  template <class C, class B>
+  RTS_ALWAYS_INLINE void while_(C cond, B body) {
+    using A = detail::condition_arch<C>;
+    detail::loop_scope<A> loop;
+    while (any(execution_mask<A> &= detail::mask_of(cond()))) {
+      body();
+      loop.next();
+    }
+  }
+
+  /// run @p body, then repeat while any lane's varying @p cond holds
+  template <class B, class C>
+  RTS_ALWAYS_INLINE void do_while_(B body, C cond) {
+    using A = detail::condition_arch<C>;
+    detail::loop_scope<A> loop;
+    do {
+      body();
+      loop.next();
+    } while (any(execution_mask<A> &= detail::mask_of(cond())));
+  }
+
+  /// @p init, then @p while_(cond, body) with @p step after the body on every lane that has not broken out
+  template <class I, class C, class S, class B>
+  RTS_ALWAYS_INLINE void for_(I init, C cond, S step, B body) {
+    using A = detail::condition_arch<C>;
+    init();
+    detail::loop_scope<A> loop;
+    while (any(execution_mask<A> &= detail::mask_of(cond()))) {
+      body();
+      loop.next();
+      step();
+    }
+  }
+
+  /// switch the active lanes off until the end of the innermost loop
+  template <class A = default_isa>
+  RTS_ALWAYS_INLINE void break_() noexcept {
+    detail::exit_lanes(detail::broken_lanes<A>);
+  }
+
+  /// switch the active lanes off until the end of the current iteration of the innermost loop
+  template <class A = default_isa>
+  RTS_ALWAYS_INLINE void continue_() noexcept {
+    detail::exit_lanes(detail::continued_lanes<A>);
+  }
+
+  /// switch the active lanes off until the end of the enclosing @p function_
+  template <class A = default_isa>
+  RTS_ALWAYS_INLINE void return_() noexcept {
+    detail::exit_lanes(detail::returned_lanes<A>);
+  }
+
+  /// run @p f as a function body: lanes that @p return_ from it, or @p break_ or @p continue_ outside a loop inside it,
+  /// resume after it
+  template <class A = default_isa, class F>
+  RTS_ALWAYS_INLINE void function_(F f) {
+    detail::function_scope<A> scope;
+    f();
+  }
+
+  /// run @p f(lane) for each lane set in @p v
+  template <class A, class F>
+  RTS_ALWAYS_INLINE void foreach_active(const varying<bool,A> & v, F f) {
+    foreach_active(v.data, f);
+  }
+
+  /// run @p f(lane) once for each active lane in turn, with only that lane on. this is how varying code calls scalar
+  /// code, such as an allocator, a hash map insert or I/O, on each of its values.
+  template <class A = default_isa, class F>
+  RTS_ALWAYS_INLINE void foreach_active(F f) {
+    detail::execution_mask_scope<A> scope;
+    std::uint32_t m = movemask(scope.old_mask);
+    while (m) {
+      const int i = bscf(m); // mutates m
+      vec<bool,A> lane(false);
+      lane.put(i, true);
+      execution_mask<A> = lane;
+      f(i);
+    }
+  }
+
+  /// run @p f(value, lanes) once for each distinct value of @p v among the active lanes, with the lanes holding it
+  /// switched on, so dispatching on mostly uniform values, e.g. material ids or opcodes, costs a call per value rather
+  /// than per lane.
+  template <class T, class A, class F>
+  RTS_ALWAYS_INLINE void foreach_unique(const varying<T,A> & v, F f) {
+    detail::execution_mask_scope<A> scope;
+    std::uint32_t m = movemask(scope.old_mask);
+    while (m) {
+      const int i = bsf(m);
+      const T value = v.get(i);
+      vec<bool,A> lanes = scope.old_mask & vec<bool,A>(v.data == vec<T,A>(value));
+      lanes.put(i, true); // a NaN matches nothing, not even itself
+      m &= ~movemask(lanes);
+      execution_mask<A> = lanes;
+      f(value, static_cast<const vec<bool,A> &>(lanes));
+    }
+  }
+
+  namespace detail {
+    // a foreach hands each step a fresh set of indices, so every step starts from its own mask with no lane exited,
+    // and whatever the enclosing code had switched off comes back on the way out
+    template <class A>
+    struct foreach_scope {
+      vec<bool,A> entry, outer_continued, outer_broken, outer_returned, outer_exited;
+
+      RTS_ALWAYS_INLINE foreach_scope() noexcept
+      : entry(execution_mask<A>), outer_continued(continued_lanes<A>), outer_broken(broken_lanes<A>)
+      , outer_returned(returned_lanes<A>), outer_exited(exited_lanes<A>) {}
+      foreach_scope(const foreach_scope & other) = delete;
+      foreach_scope(foreach_scope && other) = delete;
+
+      // constant stores, which the body sees through when the step is full
+      RTS_ALWAYS_INLINE void step(const vec<bool,A> & m) noexcept {
+        execution_mask<A> = m;
+        continued_lanes<A> = false;
+        exited_lanes<A> = false;
+      }
+
+      RTS_ALWAYS_INLINE ~foreach_scope() noexcept {
+        execution_mask<A> = entry;
+        continued_lanes<A> = outer_continued;
+        broken_lanes<A> = outer_broken;
+        returned_lanes<A> = outer_returned;
+        exited_lanes<A> = outer_exited;
+      }
+    };
+
+    // split A::width lanes into a tile of 2^bits[0] x 2^bits[1] x ..., earlier dimensions getting the larger share
+    template <class A>
+    RTS_ALWAYS_INLINE void tile_lanes(int dims, int * bits, vec<std::int32_t,A> * offsets) noexcept {
+      int left = A::shift;
+      for (int d=dims-1;d>=0;--d) {
+        bits[d] = left / (d + 1);
+        left -= bits[d];
+      }
+      for (int l=0;l<A::width;++l) {
+        int shift = 0;
+        for (int d=0;d<dims;++d) {
+          offsets[d].put(l, (l >> shift) & ((1 << bits[d]) - 1));
+          shift += bits[d];
+        }
+      }
+    }
+  }
+
+  /// run @p f over the indices [lo,hi), A::width consecutive ones per step as a @p varying<std::int32_t,A>. every step
+  /// but a partial last one runs with all lanes on, as a plain full-width body; the last runs with the lanes past @p hi
+  /// switched off. a foreach is uniform control flow: it covers every index whatever mask it is called under. the body
+  /// may @p continue_ to the next step, but not @p break_ or @p return_.
+  template <class A = default_isa, class F>
+  RTS_ALWAYS_INLINE void foreach(std::int32_t lo, std::int32_t hi, F f) {
+    using index = varying<std::int32_t,A>;
+    using ivec = vec<std::int32_t,A>;
+    if (hi <= lo) return;
+    const ivec lanes = detail::lane_indices<A>();
+    const std::int32_t full = hi - ((hi - lo) & std::int32_t(A::shift_mask));
+    detail::foreach_scope<A> scope;
+    std::int32_t i = lo;
+    for (;i < full;i += A::width) {
+      scope.step(vec<bool,A>(true));
+      f(index(lanes + ivec(i)));
+    }
+    if (i < hi) {
+      scope.step(lanes < ivec(hi - i));
+      f(index(lanes + ivec(i)));
+    }
+  }
+
+  /// @p foreach over the rectangle [x0,x1) x [y0,y1), a tile of indices per step, e.g. 4 x 2 for 8 lanes, so that
+  /// neighbouring lanes are neighbours in both directions. @p f takes the x and y indices.
+  template <class A = default_isa, class F>
+  RTS_ALWAYS_INLINE void foreach_tiled(std::int32_t x0, std::int32_t x1, std::int32_t y0, std::int32_t y1, F f) {
+    using index = varying<std::int32_t,A>;
+    using ivec = vec<std::int32_t,A>;
+    using mask = vec<bool,A>;
+    if (x1 <= x0 || y1 <= y0) return;
+    int bits[2];
+    ivec offsets[2];
+    detail::tile_lanes<A>(2, bits, offsets);
+    const std::int32_t tx = 1 << bits[0], ty = 1 << bits[1];
+    const std::int32_t xf = x1 - ((x1 - x0) & (tx - 1));
+    detail::foreach_scope<A> scope;
+    for (std::int32_t y=y0;y<y1;y+=ty) {
+      const index ys(offsets[1] + ivec(y));
+      const bool full = y + ty <= y1;
+      const mask ym = full ? mask(true) : mask(ys.data < ivec(y1));
+      std::int32_t x = x0;
+      if (full) for (;x < xf;x += tx) {
+        scope.step(mask(true));
+        f(index(offsets[0] + ivec(x)), ys);
+      }
+      for (;x < x1;x += tx) {
+        const ivec xs = offsets[0] + ivec(x);
+        scope.step(ym & mask(xs < ivec(x1)));
+        f(index(xs), ys);
+      }
+    }
+  }
+
+  /// @p foreach over the box [x0,x1) x [y0,y1) x [z0,z1), a tile of indices per step, e.g. 2 x 2 x 2 for 8 lanes.
+  /// @p f takes the x, y and z indices.
+  template <class A = default_isa, class F>
+  RTS_ALWAYS_INLINE void foreach_tiled(std::int32_t x0, std::int32_t x1, std::int32_t y0, std::int32_t y1, std::int32_t z0, std::int32_t z1, F f) {
+    using index = varying<std::int32_t,A>;
+    using ivec = vec<std::int32_t,A>;
+    using mask = vec<bool,A>;
+    if (x1 <= x0 || y1 <= y0 || z1 <= z0) return;
+    int bits[3];
+    ivec offsets[3];
+    detail::tile_lanes<A>(3, bits, offsets);
+    const std::int32_t tx = 1 << bits[0], ty = 1 << bits[1], tz = 1 << bits[2];
+    const std::int32_t xf = x1 - ((x1 - x0) & (tx - 1));
+    detail::foreach_scope<A> scope;
+    for (std::int32_t z=z0;z<z1;z+=tz) {
+      const index zs(offsets[2] + ivec(z));
+      const bool full_z = z + tz <= z1;
+      const mask zm = full_z ? mask(true) : mask(zs.data < ivec(z1));
+      for (std::int32_t y=y0;y<y1;y+=ty) {
+        const index ys(offsets[1] + ivec(y));
+        const bool full = full_z && y + ty <= y1;
+        const mask yzm = full ? mask(true) : zm & mask(ys.data < ivec(y1));
+        std::int32_t x = x0;
+        if (full) for (;x < xf;x += tx) {
+          scope.step(mask(true));
+          f(index(offsets[0] + ivec(x)), ys, zs);
+        }
+        for (;x < x1;x += tx) {
+          const ivec xs = offsets[0] + ivec(x);
+          scope.step(yzm & mask(xs < ivec(x1)));
+          f(index(xs), ys, zs);
+        }
+      }
+    }
+  }
 } // namespace rts
 
+
 namespace std {
   template <std::size_t i, class T, class A>
   RTS_ALWAYS_INLINE RTS_PURE auto get(rts::varying<T,A> & v) noexcept(noexcept(v.get(i))) {
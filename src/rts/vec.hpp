@@ -7,9 +7,11 @@
 #include <cmath>
 #include <cstdint>
 #include <functional>
+#include <limits>
 #include <tuple>
 #include <utility>
 #include "cpu.hpp"
+#include "gather.hpp"
 #include "x86.hpp"
 
 namespace rts {
@@ -210,6 +212,7 @@ namespace rts {
     RTS_ASSIGN(-=)
     RTS_ASSIGN(*=)
     RTS_ASSIGN(/=)
+    RTS_ASSIGN(%=)
     RTS_ASSIGN(<<=)
     RTS_ASSIGN(>>=)
     RTS_ASSIGN(&=)
@@ -656,8 +659,8 @@ namespace rts {
       RTS_ALWAYS_INLINE constexpr vec(std::uint32_t m) noexcept : d{m&0x01u?~0:0,m&0x02u?~0:0,m&0x04u?~0:0,m&0x08u?~0:0,m&0x10u?~0:0,m&0x20u?~0:0,m&0x40u?~0:0,m&0x80u?~0:0} {}
       RTS_ALWAYS_INLINE constexpr vec(bool a, bool b, bool c, bool d, bool e, bool f, bool g, bool h) noexcept : d{a?~0:0,b?~0:0,c?~0:0,d?~0:0,e?~0:0,f?~0:0,g?~0:0,h?~0:0} {}
 
-      RTS_ALWAYS_INLINE RTS_PURE vec operator ~ () noexcept { return *this ^ vec(std::true_type()); }
-      RTS_ALWAYS_INLINE RTS_PURE vec operator ! () noexcept { return *this ^ vec(std::true_type()); }
+      RTS_ALWAYS_INLINE RTS_PURE vec operator ~ () const noexcept { return *this ^ vec(std::true_type()); }
+      RTS_ALWAYS_INLINE RTS_PURE vec operator ! () const noexcept { return *this ^ vec(std::true_type()); }
       RTS_ALWAYS_INLINE RTS_PURE vec operator & (const vec & rhs) const noexcept { return vec(_mm256_and_si256(m,rhs.m), detail::internal_tag); }
       RTS_ALWAYS_INLINE RTS_PURE vec operator | (const vec & rhs) const noexcept { return vec(_mm256_or_si256(m,rhs.m), detail::internal_tag); }
       RTS_ALWAYS_INLINE RTS_PURE vec operator ^ (const vec & rhs) const noexcept { return vec(_mm256_xor_si256(m,rhs.m), detail::internal_tag); }
@@ -668,7 +671,7 @@ namespace rts {
       RTS_ALWAYS_INLINE vec & operator &= (const vec & rhs) noexcept { m = _mm256_and_si256(m,rhs.m); return *this; }
       RTS_ALWAYS_INLINE vec & operator |= (const vec & rhs) noexcept { m = _mm256_or_si256(m,rhs.m); return *this; }
       RTS_ALWAYS_INLINE vec & operator ^= (const vec & rhs) noexcept { m = _mm256_xor_si256(m,rhs.m); return *this; }
-      RTS_ALWAYS_INLINE RTS_PURE bool get(int i) noexcept { return movemask()&(1<<i); }
+      RTS_ALWAYS_INLINE RTS_PURE bool get(int i) const noexcept { return movemask()&(1<<i); }
       RTS_ALWAYS_INLINE void put(int i, bool b) noexcept { reinterpret_cast<std::int32_t*>(&m)[i] = b?~0:0; }
       RTS_ALWAYS_INLINE RTS_PURE std::uint32_t movemask() const noexcept { return _mm256_movemask_ps(_mm256_castsi256_ps(m)); }
     }; // vec<bool,avx2_8>
@@ -705,6 +708,14 @@ namespace rts {
   }
 
   namespace detail {
+    // lanes of a vector of A::width elements, each holding its own index
+    template <class A>
+    RTS_ALWAYS_INLINE RTS_PURE vec<std::int32_t,A> lane_indices() noexcept {
+      vec<std::int32_t,A> result;
+      for (int i=0;i<A::width;++i) result.put(i, i);
+      return result;
+    }
+
     template <class T, class A> struct loader;
 
     template <class T, class A>
@@ -1207,9 +1218,9 @@ namespace rts {
 
       RTS_ALWAYS_INLINE constexpr vec() noexcept : d{nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr} {}
       RTS_ALWAYS_INLINE constexpr vec(std::nullptr_t) noexcept : d{nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr} {}
-      RTS_ALWAYS_INLINE constexpr vec(T * a) noexcept : d(a,a,a,a) {}
-      RTS_ALWAYS_INLINE constexpr vec(const vec & rhs) noexcept : m(d.m) {}
-      RTS_ALWAYS_INLINE vec(vec && rhs) noexcept : m(std::move(d.m)) {}
+      RTS_ALWAYS_INLINE constexpr vec(T * a) noexcept : d{a,a,a,a,a,a,a,a} {}
+      RTS_ALWAYS_INLINE vec(const vec & rhs) noexcept { for (int i=0;i<arch::width;++i) d[i] = rhs.d[i]; }
+      RTS_ALWAYS_INLINE vec(vec && rhs) noexcept { for (int i=0;i<arch::width;++i) d[i] = rhs.d[i]; }
 
       RTS_ALWAYS_INLINE RTS_CONST RTS_MUTABLE_CONSTEXPR iterator begin() noexcept { return d; }
       RTS_ALWAYS_INLINE RTS_CONST RTS_MUTABLE_CONSTEXPR iterator end() noexcept { return d + arch::width; }
@@ -1222,7 +1233,7 @@ namespace rts {
       RTS_ALWAYS_INLINE RTS_CONST RTS_MUTABLE_CONSTEXPR reference get(int i) noexcept { return d[i]; }
       RTS_ALWAYS_INLINE RTS_CONST constexpr const_reference get(int i) const noexcept { return d[i]; }
       RTS_ALWAYS_INLINE void put(int i, T * p) noexcept { d[i] = p; }
-      RTS_ALWAYS_INLINE vec & operator = (const vec & rhs) noexcept { m = rhs.m; return *this; }
+      RTS_ALWAYS_INLINE vec & operator = (const vec & rhs) noexcept { for (int i=0;i<arch::width;++i) d[i] = rhs.d[i]; return *this; }
     };
 
     // we need vec<T * const,avx2_8> as well
@@ -1248,9 +1259,9 @@ namespace rts {
 
       RTS_ALWAYS_INLINE constexpr vec() noexcept : d{nullptr,nullptr,nullptr,nullptr} {}
       RTS_ALWAYS_INLINE constexpr vec(std::nullptr_t) noexcept : d{nullptr,nullptr,nullptr,nullptr} {}
-      RTS_ALWAYS_INLINE constexpr vec(T * a) noexcept : d(a,a,a,a) {}
-      RTS_ALWAYS_INLINE constexpr vec(const vec & rhs) noexcept : m(d.m) {}
-      RTS_ALWAYS_INLINE vec(vec && rhs) noexcept : m(std::move(d.m)) {}
+      RTS_ALWAYS_INLINE constexpr vec(T * a) noexcept : d{a,a,a,a} {}
+      RTS_ALWAYS_INLINE vec(const vec & rhs) noexcept { for (int i=0;i<arch::width;++i) d[i] = rhs.d[i]; }
+      RTS_ALWAYS_INLINE vec(vec && rhs) noexcept { for (int i=0;i<arch::width;++i) d[i] = rhs.d[i]; }
 
       RTS_ALWAYS_INLINE RTS_CONST RTS_MUTABLE_CONSTEXPR iterator begin() noexcept { return d; }
       RTS_ALWAYS_INLINE RTS_CONST RTS_MUTABLE_CONSTEXPR iterator end() noexcept { return d + arch::width; }
@@ -1263,7 +1274,7 @@ namespace rts {
       RTS_ALWAYS_INLINE RTS_CONST RTS_MUTABLE_CONSTEXPR reference get(int i) noexcept { return d[i]; }
       RTS_ALWAYS_INLINE RTS_CONST constexpr const_reference get(int i) const noexcept { return d[i]; }
       RTS_ALWAYS_INLINE void put(int i, T * p) noexcept { d[i] = p; }
-      RTS_ALWAYS_INLINE vec & operator = (const vec & rhs) noexcept { m = rhs.m; return *this; }
+      RTS_ALWAYS_INLINE vec & operator = (const vec & rhs) noexcept { for (int i=0;i<arch::width;++i) d[i] = rhs.d[i]; return *this; }
     };
 
     // template <> struct loader<float,avx_4> : base_loader<float,avx_4> {}
@@ -1294,9 +1305,9 @@ namespace rts {
 
       RTS_ALWAYS_INLINE constexpr vec() noexcept : d{nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr} {}
       RTS_ALWAYS_INLINE constexpr vec(std::nullptr_t) noexcept : d{nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr} {}
-      RTS_ALWAYS_INLINE constexpr vec(T * a) noexcept : d(a,a,a,a,a,a,a,a) {}
-      RTS_ALWAYS_INLINE constexpr vec(const vec & rhs) noexcept : m(d.m) {}
-      RTS_ALWAYS_INLINE vec(vec && rhs) noexcept : m(std::move(d.m)) {}
+      RTS_ALWAYS_INLINE constexpr vec(T * a) noexcept : d{a,a,a,a,a,a,a,a} {}
+      RTS_ALWAYS_INLINE vec(const vec & rhs) noexcept { for (int i=0;i<arch::width;++i) d[i] = rhs.d[i]; }
+      RTS_ALWAYS_INLINE vec(vec && rhs) noexcept { for (int i=0;i<arch::width;++i) d[i] = rhs.d[i]; }
 
       RTS_ALWAYS_INLINE RTS_CONST RTS_MUTABLE_CONSTEXPR iterator begin() noexcept { return d; }
       RTS_ALWAYS_INLINE RTS_CONST RTS_MUTABLE_CONSTEXPR iterator end() noexcept { return d + arch::width; }
@@ -1309,16 +1320,60 @@ namespace rts {
       RTS_ALWAYS_INLINE RTS_CONST RTS_MUTABLE_CONSTEXPR reference get(int i) noexcept { return d[i]; }
       RTS_ALWAYS_INLINE RTS_CONST constexpr const_reference get(int i) const noexcept { return d[i]; }
       RTS_ALWAYS_INLINE void put(int i, T * p) noexcept { begin()[i] = p; }
-      RTS_ALWAYS_INLINE vec & operator = (const vec & rhs) noexcept { m = rhs.m; return *this; }
+      RTS_ALWAYS_INLINE vec & operator = (const vec & rhs) noexcept { for (int i=0;i<arch::width;++i) d[i] = rhs.d[i]; return *this; }
     };
 
     namespace detail {
 
-      // this should probably be disabled as manual gathers are faster than avx2 gathers
-      // but this allows us to test the code path
+      // alternative gathers of 32 bit lanes, selected at runtime by active_gather_strategy
+      struct avx2_gather32 {
+        template <class T>
+        RTS_ALWAYS_INLINE static __m256i scalar(const vec<T*,target::avx2_8> & v) noexcept {
+          static_assert(sizeof(T) == 4, "32 bit lanes only");
+          return _mm256_setr_epi32(
+            *reinterpret_cast<const std::int32_t*>(v.d[0]), *reinterpret_cast<const std::int32_t*>(v.d[1]),
+            *reinterpret_cast<const std::int32_t*>(v.d[2]), *reinterpret_cast<const std::int32_t*>(v.d[3]),
+            *reinterpret_cast<const std::int32_t*>(v.d[4]), *reinterpret_cast<const std::int32_t*>(v.d[5]),
+            *reinterpret_cast<const std::int32_t*>(v.d[6]), *reinterpret_cast<const std::int32_t*>(v.d[7]));
+        }
+
+        // If every lane points into the 64 bytes starting at the 32 byte block holding lane 0, then
+        // two aligned loads and a pair of permutes replace the gather. Aligned blocks never straddle
+        // a page, so this can't fault where the scalar loads would not. Returns false otherwise.
+        template <class T>
+        RTS_ALWAYS_INLINE static bool permute(__m256i & r, const vec<T*,target::avx2_8> & v) noexcept {
+          static_assert(sizeof(T) == 4, "32 bit lanes only");
+          const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(v.d[0]) & ~std::uintptr_t(31);
+          #ifdef RTS_64
+            const __m256i b = _mm256_set1_epi64x(static_cast<std::int64_t>(base));
+            const __m256i lo = _mm256_sub_epi64(v.m[0], b);
+            const __m256i hi = _mm256_sub_epi64(v.m[1], b);
+            // offsets must lie in [0,64) and be multiples of 4
+            if (!_mm256_testz_si256(_mm256_or_si256(lo,hi), _mm256_set1_epi64x(~std::int64_t(0x3c)))) return false;
+            const __m256i evens = _mm256_setr_epi32(0,2,4,6,0,2,4,6);
+            const __m256i off = _mm256_permute2x128_si256(
+                _mm256_permutevar8x32_epi32(lo, evens)
+              , _mm256_permutevar8x32_epi32(hi, evens)
+              , 0x20);
+          #else
+            const __m256i off = _mm256_sub_epi32(v.m, _mm256_set1_epi32(static_cast<std::int32_t>(base)));
+            if (!_mm256_testz_si256(off, _mm256_set1_epi32(~0x3c))) return false;
+          #endif
+          const __m256i idx = _mm256_srli_epi32(off, 2);
+          const __m256i * p = reinterpret_cast<const __m256i *>(base);
+          const __m256i x = _mm256_load_si256(p);
+          const __m256i y = _mm256_testz_si256(off, _mm256_set1_epi32(0x20)) ? x : _mm256_load_si256(p + 1);
+          r = _mm256_castps_si256(_mm256_blendv_ps(
+              _mm256_castsi256_ps(_mm256_permutevar8x32_epi32(x, idx))
+            , _mm256_castsi256_ps(_mm256_permutevar8x32_epi32(y, idx))
+            , _mm256_castsi256_ps(_mm256_slli_epi32(idx, 28)))); // bit 3 of the index picks the block
+          return true;
+        }
+      };
+
       template <>
       struct loader<std::int32_t,target::avx2_8> : base_loader<std::int32_t,target::avx2_8> {
-        RTS_ALWAYS_INLINE static void load_masked(vector & u, pointers v, mask m) noexcept {
+        RTS_ALWAYS_INLINE static void hardware_load_masked(vector & u, pointers v, mask m) noexcept {
           #ifdef RTS_64
             // i'd merge these with _mm256_set_m128i, but gcc helpfully forgot to include it
             u.h = _mm256_mask_i64gather_epi32(
@@ -1338,7 +1393,7 @@ namespace rts {
           #endif
         }
 
-        RTS_ALWAYS_INLINE static void load(vector & u, pointers v) noexcept {
+        RTS_ALWAYS_INLINE static void hardware_load(vector & u, pointers v) noexcept {
           #if RTS_64
             u.h = _mm256_i64gather_epi32(nullptr, v.m[1], 1);
             u.l = _mm256_i64gather_epi32(nullptr, v.m[0], 1);
@@ -1346,11 +1401,32 @@ namespace rts {
             u.m = _mm256_i32gather_epi32(nullptr, v.m, 1);
           #endif
         }
+
+        // masked lanes may hold garbage pointers, so only the scalar and hardware paths apply
+        RTS_ALWAYS_INLINE static void load_masked(vector & u, pointers v, mask m) noexcept {
+          if (active_gather_strategy == gather_strategy::scalar)
+            base_loader::load_masked(u, v, m);
+          else
+            hardware_load_masked(u, v, m);
+        }
+
+        RTS_ALWAYS_INLINE static void load(vector & u, pointers v) noexcept {
+          switch (active_gather_strategy) {
+            case gather_strategy::scalar:
+              u.m = avx2_gather32::scalar(v);
+              return;
+            case gather_strategy::permute:
+              if (avx2_gather32::permute(u.m, v)) return;
+              // fall through
+            default:
+              hardware_load(u, v);
+          }
+        }
       };
 
       template <>
       struct loader<float,target::avx2_8> : base_loader<float,target::avx2_8> {
-        RTS_ALWAYS_INLINE static void load_masked(vector & u, pointers v, mask m) noexcept {
+        RTS_ALWAYS_INLINE static void hardware_load_masked(vector & u, pointers v, mask m) noexcept {
           #ifdef RTS_64
             u.l = _mm256_mask_i64gather_ps(
                   _mm256_extractf128_ps(u.m,0)
@@ -1371,7 +1447,7 @@ namespace rts {
           #endif
         }
 
-        RTS_ALWAYS_INLINE static void load(vector & u, pointers v) noexcept {
+        RTS_ALWAYS_INLINE static void hardware_load(vector & u, pointers v) noexcept {
           #ifdef RTS_64
             u.l = _mm256_i64gather_ps(nullptr, v.m[0], 1);
             u.h = _mm256_i64gather_ps(nullptr, v.m[1], 1);
@@ -1379,6 +1455,27 @@ namespace rts {
             u.m = _mm256_i32gather_ps(nullptr, v.m, 1);
           #endif
         }
+
+        RTS_ALWAYS_INLINE static void load_masked(vector & u, pointers v, mask m) noexcept {
+          if (active_gather_strategy == gather_strategy::scalar)
+            base_loader::load_masked(u, v, m);
+          else
+            hardware_load_masked(u, v, m);
+        }
+
+        RTS_ALWAYS_INLINE static void load(vector & u, pointers v) noexcept {
+          __m256i r;
+          switch (active_gather_strategy) {
+            case gather_strategy::scalar:
+              u.m = _mm256_castsi256_ps(avx2_gather32::scalar(v));
+              return;
+            case gather_strategy::permute:
+              if (avx2_gather32::permute(r, v)) { u.m = _mm256_castsi256_ps(r); return; }
+              // fall through
+            default:
+              hardware_load(u, v);
+          }
+        }
       };
     }
 
@@ -1388,10 +1485,10 @@ namespace rts {
   RTS_ALWAYS_INLINE vec<T,A> load(const vec<T*,A> & pointers, const vec<bool,A> & mask) noexcept(
     std::is_nothrow_move_constructible<vec<T,A>>::value &&
     std::is_nothrow_copy_constructible<vec<T,A>>::value &&
-    noexcept(detail::loader<T,A>::load_masked(vec<T,A>(),pointers,mask))
+    noexcept(detail::loader<T,A>::load_masked(std::declval<vec<T,A>&>(),pointers,mask))
   ) {
     vec<T,A> result;
-    detail::loader<T,A>::load(result, pointers, mask);
+    detail::loader<T,A>::load_masked(result, pointers, mask);
     return result;
   }
 
@@ -1399,7 +1496,7 @@ namespace rts {
   RTS_ALWAYS_INLINE vec<T,A> load(const vec<T*,A> & pointers) noexcept(
     std::is_nothrow_move_constructible<vec<T,A>>::value &&
     std::is_nothrow_copy_constructible<vec<T,A>>::value &&
-    noexcept(detail::loader<T,A>::load(vec<T,A>(),pointers))
+    noexcept(detail::loader<T,A>::load(std::declval<vec<T,A>&>(),pointers))
   ) {
     vec<T,A> result;
     detail::loader<T,A>::load(result, pointers);
@@ -1420,6 +1517,235 @@ namespace rts {
     detail::loader<T,A>::store(pointers, t);
   }
 
+  /// non-temporal store of a whole vector, bypassing the cache where the lane type has a streaming instruction.
+  /// @p p must be aligned to @p A::alignment. Follow a run of these with @p stream_fence before the data is shared.
+  template <class T, class A>
+  RTS_ALWAYS_INLINE void stream(vec<T,A> & p, const vec<T,A> & v) noexcept(std::is_nothrow_copy_assignable<vec<T,A>>::value) {
+    p = v;
+  }
+
+  #ifdef __AVX__
+  RTS_ALWAYS_INLINE void stream(vec<float,target::avx_8> & p, const vec<float,target::avx_8> & v) noexcept { _mm256_stream_ps(p.d, v.m); }
+  RTS_ALWAYS_INLINE void stream(vec<float,target::avx_4> & p, const vec<float,target::avx_4> & v) noexcept { _mm_stream_ps(p.d, v.m); }
+  RTS_ALWAYS_INLINE void stream(vec<std::int32_t,target::avx_8> & p, const vec<std::int32_t,target::avx_8> & v) noexcept { _mm256_stream_si256(&p.m, v.m); }
+  RTS_ALWAYS_INLINE void stream(vec<std::int32_t,target::avx_4> & p, const vec<std::int32_t,target::avx_4> & v) noexcept { _mm_stream_si128(&p.m, v.m); }
+  #endif
+
+  #ifdef __AVX2__
+  RTS_ALWAYS_INLINE void stream(vec<float,target::avx2_8> & p, const vec<float,target::avx2_8> & v) noexcept { _mm256_stream_ps(p.d, v.m); }
+  RTS_ALWAYS_INLINE void stream(vec<std::int32_t,target::avx2_8> & p, const vec<std::int32_t,target::avx2_8> & v) noexcept { _mm256_stream_si256(&p.m, v.m); }
+  #endif
+
+  /// order prior @p stream stores before any later store
+  RTS_ALWAYS_INLINE void stream_fence() noexcept {
+    _mm_sfence();
+  }
+
+  // --------------------------------------------------------------------------------
+  // * vec<based_ptr<T>>
+  // --------------------------------------------------------------------------------
+
+  /// lane type for pointers into a single arena: one shared base pointer and a @p vec<std::int32_t,A> of element offsets.
+  ///
+  /// On 64 bit targets this is half the register footprint of @p vec<T*,A>, and gathers with one @p vpgatherdd.
+  /// Every lane must lie within 2^31 elements of the base.
+  template <class T> struct based_ptr;
+
+  /// another name for @p based_ptr
+  template <class T> using index = based_ptr<T>;
+
+  template <class T, class A>
+  struct vec<based_ptr<T>,A> {
+    using arch = A;
+    using value_type = T*;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using offsets = vec<std::int32_t,A>;
+
+    T * base;
+    offsets offset; ///< in elements of @p T
+
+    RTS_ALWAYS_INLINE constexpr vec() noexcept : base(nullptr), offset() {}
+    RTS_ALWAYS_INLINE explicit constexpr vec(T * base) noexcept : base(base), offset() {}
+    RTS_ALWAYS_INLINE constexpr vec(T * base, const offsets & offset) noexcept : base(base), offset(offset) {}
+    RTS_ALWAYS_INLINE constexpr vec(const vec & rhs) noexcept = default;
+    RTS_ALWAYS_INLINE vec(vec && rhs) noexcept = default;
+
+    RTS_ALWAYS_INLINE vec & operator=(const vec & rhs) noexcept = default;
+    RTS_ALWAYS_INLINE vec & operator=(vec && rhs) noexcept = default;
+
+    RTS_ALWAYS_INLINE RTS_PURE constexpr T * get(int i) const noexcept { return base + offset.get(i); }
+    RTS_ALWAYS_INLINE void put(int i, T * p) noexcept { offset.put(i, static_cast<std::int32_t>(p - base)); }
+
+    /// the same lanes as full pointers
+    RTS_ALWAYS_INLINE RTS_PURE vec<T*,A> widen() const noexcept {
+      vec<T*,A> result;
+      for (int i=0;i<A::width;++i) result.put(i, get(i));
+      return result;
+    }
+
+    /// the offsets that address the same lanes from another base
+    RTS_ALWAYS_INLINE RTS_PURE offsets offsets_from(const T * other) const noexcept {
+      return other == base ? offset : offsets(offset + offsets(static_cast<std::int32_t>(base - other)));
+    }
+
+    RTS_ALWAYS_INLINE vec & operator += (const offsets & d) noexcept { offset = offset + d; return *this; }
+    RTS_ALWAYS_INLINE vec & operator -= (const offsets & d) noexcept { offset = offset - d; return *this; }
+    RTS_ALWAYS_INLINE vec & operator += (std::int32_t d) noexcept { return *this += offsets(d); }
+    RTS_ALWAYS_INLINE vec & operator -= (std::int32_t d) noexcept { return *this -= offsets(d); }
+    RTS_ALWAYS_INLINE vec & operator ++ () noexcept { return *this += 1; }
+    RTS_ALWAYS_INLINE vec & operator -- () noexcept { return *this -= 1; }
+    RTS_ALWAYS_INLINE vec operator ++ (int) noexcept { vec t(*this); *this += 1; return t; }
+    RTS_ALWAYS_INLINE vec operator -- (int) noexcept { vec t(*this); *this -= 1; return t; }
+
+    RTS_ALWAYS_INLINE void swap(vec & that) noexcept {
+      std::swap(base,that.base);
+      std::swap(offset,that.offset);
+    }
+  };
+
+  template <class T, class A>
+  RTS_ALWAYS_INLINE RTS_PURE vec<based_ptr<T>,A> operator + (const vec<based_ptr<T>,A> & p, const vec<std::int32_t,A> & d) noexcept {
+    return vec<based_ptr<T>,A>(p.base, p.offset + d);
+  }
+
+  template <class T, class A>
+  RTS_ALWAYS_INLINE RTS_PURE vec<based_ptr<T>,A> operator + (const vec<std::int32_t,A> & d, const vec<based_ptr<T>,A> & p) noexcept {
+    return vec<based_ptr<T>,A>(p.base, p.offset + d);
+  }
+
+  template <class T, class A>
+  RTS_ALWAYS_INLINE RTS_PURE vec<based_ptr<T>,A> operator + (const vec<based_ptr<T>,A> & p, std::int32_t d) noexcept {
+    return vec<based_ptr<T>,A>(p.base, p.offset + vec<std::int32_t,A>(d));
+  }
+
+  template <class T, class A>
+  RTS_ALWAYS_INLINE RTS_PURE vec<based_ptr<T>,A> operator - (const vec<based_ptr<T>,A> & p, const vec<std::int32_t,A> & d) noexcept {
+    return vec<based_ptr<T>,A>(p.base, p.offset - d);
+  }
+
+  template <class T, class A>
+  RTS_ALWAYS_INLINE RTS_PURE vec<based_ptr<T>,A> operator - (const vec<based_ptr<T>,A> & p, std::int32_t d) noexcept {
+    return vec<based_ptr<T>,A>(p.base, p.offset - vec<std::int32_t,A>(d));
+  }
+
+  /// lane-wise distance in elements
+  template <class T, class A>
+  RTS_ALWAYS_INLINE RTS_PURE vec<std::int32_t,A> operator - (const vec<based_ptr<T>,A> & l, const vec<based_ptr<T>,A> & r) noexcept {
+    return l.offset - r.offsets_from(l.base);
+  }
+
+  #define RTS_BASED_CMP(op) \
+    template <class T, class A> \
+    RTS_ALWAYS_INLINE RTS_PURE auto operator op (const vec<based_ptr<T>,A> & l, const vec<based_ptr<T>,A> & r) noexcept { \
+      return l.offset op r.offsets_from(l.base); \
+    }
+
+  RTS_BASED_CMP(==)
+  RTS_BASED_CMP(!=)
+  RTS_BASED_CMP(<)
+  RTS_BASED_CMP(<=)
+  RTS_BASED_CMP(>)
+  RTS_BASED_CMP(>=)
+
+  #undef RTS_BASED_CMP
+
+  namespace detail {
+    template <class T, class A>
+    struct base_based_loader {
+      using vector = vec<T,A>;
+      using pointers = const vec<based_ptr<T>,A> &;
+      using mask = const vec<bool,A> &;
+
+      RTS_ALWAYS_INLINE static void load_masked(vector & u, pointers v, mask m) noexcept(noexcept(u.put(0,*v.get(0)))) {
+        foreach_active(m, [&](int i) { u.put(i, v.base[v.offset.get(i)]); });
+      }
+
+      RTS_ALWAYS_INLINE static void load(vector & u, pointers v) noexcept(noexcept(u.put(0,*v.get(0)))) {
+        for (int i=0;i<A::width;++i) u.put(i, v.base[v.offset.get(i)]);
+      }
+
+      RTS_ALWAYS_INLINE static void store_masked(pointers v, const vector & u, mask m) noexcept(noexcept(*v.get(0) = u.get(0))) {
+        foreach_active(m, [&](int i) { v.base[v.offset.get(i)] = u.get(i); });
+      }
+
+      RTS_ALWAYS_INLINE static void store(pointers v, const vector & u) noexcept(noexcept(*v.get(0) = u.get(0))) {
+        for (int i=0;i<A::width;++i) v.base[v.offset.get(i)] = u.get(i);
+      }
+    };
+
+    template <class T, class A> struct based_loader : base_based_loader<T,A> {};
+
+  #ifdef __AVX2__
+    // one vpgatherdd with the element size as the scale, unless the scalar strategy is pinned
+    template <>
+    struct based_loader<std::int32_t,target::avx2_8> : base_based_loader<std::int32_t,target::avx2_8> {
+      RTS_ALWAYS_INLINE static void load_masked(vector & u, pointers v, mask m) noexcept {
+        if (active_gather_strategy == gather_strategy::scalar)
+          base_based_loader::load_masked(u, v, m);
+        else
+          u.m = _mm256_mask_i32gather_epi32(u.m, reinterpret_cast<const int *>(v.base), v.offset.m, m.m, 4);
+      }
+
+      RTS_ALWAYS_INLINE static void load(vector & u, pointers v) noexcept {
+        if (active_gather_strategy == gather_strategy::scalar)
+          base_based_loader::load(u, v);
+        else
+          u.m = _mm256_i32gather_epi32(reinterpret_cast<const int *>(v.base), v.offset.m, 4);
+      }
+    };
+
+    template <>
+    struct based_loader<float,target::avx2_8> : base_based_loader<float,target::avx2_8> {
+      RTS_ALWAYS_INLINE static void load_masked(vector & u, pointers v, mask m) noexcept {
+        if (active_gather_strategy == gather_strategy::scalar)
+          base_based_loader::load_masked(u, v, m);
+        else
+          u.m = _mm256_mask_i32gather_ps(u.m, v.base, v.offset.m, _mm256_castsi256_ps(m.m), 4);
+      }
+
+      RTS_ALWAYS_INLINE static void load(vector & u, pointers v) noexcept {
+        if (active_gather_strategy == gather_strategy::scalar)
+          base_based_loader::load(u, v);
+        else
+          u.m = _mm256_i32gather_ps(v.base, v.offset.m, 4);
+      }
+    };
+  #endif
+  }
+
+  template <class T, class A>
+  RTS_ALWAYS_INLINE vec<T,A> load(const vec<based_ptr<T>,A> & pointers, const vec<bool,A> & mask) noexcept(
+    noexcept(detail::based_loader<T,A>::load_masked(std::declval<vec<T,A>&>(),pointers,mask))
+  ) {
+    vec<T,A> result;
+    detail::based_loader<T,A>::load_masked(result, pointers, mask);
+    return result;
+  }
+
+  template <class T, class A>
+  RTS_ALWAYS_INLINE vec<T,A> load(const vec<based_ptr<T>,A> & pointers) noexcept(
+    noexcept(detail::based_loader<T,A>::load(std::declval<vec<T,A>&>(),pointers))
+  ) {
+    vec<T,A> result;
+    detail::based_loader<T,A>::load(result, pointers);
+    return result;
+  }
+
+  template <class T, class A>
+  RTS_ALWAYS_INLINE void store(const vec<based_ptr<T>,A> & pointers, const vec<T,A> & t, const vec<bool,A> & mask) noexcept(
+    noexcept(detail::based_loader<T,A>::store_masked(pointers, t, mask))
+  ) {
+    detail::based_loader<T,A>::store_masked(pointers, t, mask);
+  }
+
+  template <class T, class A>
+  RTS_ALWAYS_INLINE void store(const vec<based_ptr<T>,A> & pointers, const vec<T,A> & t) noexcept(
+    noexcept(detail::based_loader<T,A>::store(pointers, t))
+  ) {
+    detail::based_loader<T,A>::store(pointers, t);
+  }
+
   namespace detail {
     template <class T, class A> struct vrefptr;
 
@@ -1712,8 +2038,8 @@ namespace rts {
     RTS_ALWAYS_INLINE RTS_CONST RTS_MUTABLE_CONSTEXPR reference operator [] (int i) noexcept { return begin()[i]; }
     RTS_ALWAYS_INLINE RTS_CONST constexpr const_reference operator [] (int i) const noexcept { return cbegin()[i]; }
     
-    RTS_ALWAYS_INLINE RTS_PURE RTS_MUTABLE_CONSTEXPR auto get(int i) noexcept(noexcept(make_pair(first.get(i), second.get(i)))) { return make_pair(first.get(i), second.get(i)); }
-    RTS_ALWAYS_INLINE RTS_PURE constexpr auto get(int i) const noexcept(noexcept(make_pair(first.get(i),second.get(i)))) { return make_pair(first.get(i),second.get(i)); }
+    RTS_ALWAYS_INLINE RTS_PURE RTS_MUTABLE_CONSTEXPR auto get(int i) noexcept(noexcept(std::make_pair(first.get(i), second.get(i)))) { return std::make_pair(first.get(i), second.get(i)); }
+    RTS_ALWAYS_INLINE RTS_PURE constexpr auto get(int i) const noexcept(noexcept(std::make_pair(first.get(i),second.get(i)))) { return std::make_pair(first.get(i),second.get(i)); }
 
     RTS_ALWAYS_INLINE void put(int i, const std::pair<S,T> & v) noexcept(noexcept(first.put(i, v.first))) {
       first.put(i, v.first);
@@ -1776,7 +2102,7 @@ namespace rts {
 
     RTS_ALWAYS_INLINE void put(int i, const std::tuple<Ts...> & v) noexcept(noexcept(detail::put1<0>(data,i,v))) {
       detail::index_apply<std::tuple_size<value_type>{}>(
-        [&](auto... Is) { RTS_UNUSED auto l = { detail::put1<Is>(data,i,v)... }; }
+        [&](auto... Is) { RTS_UNUSED auto l = { (detail::put1<Is>(data,i,v), 0)... }; }
       );
     }
 
@@ -1841,6 +2167,7 @@ namespace rts {
   RTS_BINOP(-)
   RTS_BINOP(*)
   RTS_BINOP(/)
+  RTS_BINOP(%)
   RTS_BINOP_LHS(<<)
   RTS_BINOP_LHS(>>)
   RTS_BINOP(&)
@@ -56,7 +56,7 @@ namespace rts {
   /// bit scan forward
   static RTS_ALWAYS_INLINE RTS_CONST int bsf(std::uint32_t v) noexcept {
     #if ((__GNUC__ >= 4) || ((__GNUC__ == 3) && (__GNUC_MINOR__ >= 4)))
-      #if defined(__AVX2__)
+      #if defined(__BMI__)
         return rts_tzcnt_u32(v);
       #else
         return __builtin_ctz(v);
@@ -75,7 +75,7 @@ namespace rts {
 #if !defined(_MSC_VER) || defined(_WIN64)
   static RTS_ALWAYS_INLINE RTS_CONST int bsf(std::uint64_t v) noexcept {
     #if ((__GNUC__ >= 4) || ((__GNUC__ == 3) && (__GNUC_MINOR__ >= 4)))
-      #if defined(__AVX2__)
+      #if defined(__BMI__)
         return (int)rts_tzcnt_u64(v);
       #else
         return __builtin_ctzll(v);
@@ -108,6 +108,15 @@ namespace rts {
   }
 #endif
 
+  /// number of set bits
+  static RTS_ALWAYS_INLINE int popcnt(std::uint32_t v) noexcept {
+  #if defined(_MSC_VER)
+    return (int)__popcnt(v);
+  #else
+    return __builtin_popcount(v);
+  #endif
+  }
+
 /// @defgroup rtm RTM
 /// @brief Restricted Transactional Memory
 ///
@@ -3,6 +3,14 @@
 #include "catch.hpp"
 #include "rts.hpp"
 #include "type.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
 
 using namespace rts;
 
@@ -17,10 +25,695 @@ template <class T, class A, class B> bool het_eq(const vec<T,A> & lhs, const vec
 
 template <class A> void arch_test() {
   SECTION(type<A>()) {
-    // soa<int,50,A> x;
+    soa<float,50,A> x(1.f), y(2.f), z;
+    z = x + y * y;
+    for (int i=0;i<50;++i) REQUIRE(z.get(i) == 5.f);
+    stream_assign(z, x - y);
+    for (int i=0;i<50;++i) REQUIRE(z.get(i) == -1.f);
+    stream_assign(z, sqrt(y * y), 0); // without prefetching
+    for (int i=0;i<50;++i) REQUIRE(z.get(i) == 2.f);
+    static soa<std::int32_t,5000,A> big(3), out; // long enough to run the prefetching loop
+    stream_assign(out, -big);
+    for (int i=0;i<5000;++i) REQUIRE(out.get(i) == -3);
+    unrolled_assign(z, x + y);
+    for (int i=0;i<50;++i) REQUIRE(z.get(i) == 3.f);
+    unrolled_assign<3>(z, exp(x - x) * y);
+    for (int i=0;i<50;++i) REQUIRE(z.get(i) == 2.f);
   }
 }
 
+template <class A> void soa_vector_test() {
+  SECTION(type<A>()) {
+    soa_vector<float,A> x, y(37, 2.f);
+    REQUIRE(x.empty());
+    for (int i=0;i<37;++i) x.push_back(float(i));
+    REQUIRE(x.size() == 37);
+    REQUIRE(x.capacity() >= 37);
+    soa_vector<float,A> z(37, x * y + y);
+    for (int i=0;i<37;++i) REQUIRE(z.get(i) == 2.f * i + 2.f);
+    REQUIRE(z.last_mask().get(0) == (37 % A::width != 0));
+    z -= x;
+    for (int i=0;i<37;++i) REQUIRE(z.get(i) == i + 2.f);
+    // the lanes past size() hold zero, and must not change
+    soa_vector<float,A> f(37, 1.f);
+    f /= soa_vector<float,A>(37, 2.f);
+    for (int i=0;i<37;++i) REQUIRE(f.get(i) == 0.5f);
+    if (f.needs_last())
+      for (int i=37 % A::width;i<A::width;++i) REQUIRE(f.vget(f.wsize()).get(i) == 0.f);
+    stream_assign(z, sqrt(y * y));
+    for (int i=0;i<37;++i) REQUIRE(z.get(i) == 2.f);
+    soa_vector<float,A> u(37);
+    unrolled_assign<8>(u, x - y);
+    for (int i=0;i<37;++i) REQUIRE(u.get(i) == i - 2.f);
+    blocked_assign(u, x * y - y, 2);
+    for (int i=0;i<37;++i) REQUIRE(u.get(i) == 2.f * i - 2.f);
+
+    const std::size_t n = 100003;
+    soa_vector<float,A> p(n), q(n, 3.f), r(n, 1.f), o(n);
+    for (std::size_t i=0;i<n;++i) p.put(i, float(i % 1000));
+    REQUIRE(default_tile<decltype(p * q + r)>() > 0);
+    blocked_assign(o, p * q + r);
+    for (std::size_t i=0;i<n;++i) REQUIRE(o.get(i) == 3.f * float(i % 1000) + 1.f);
+
+    z.push_back(vec<float,A>(7.f)); // straddles a vector boundary unless the width is 1
+    REQUIRE(z.size() == std::size_t(37 + A::width));
+    for (int i=0;i<A::width;++i) REQUIRE(z.get(37+i) == 7.f);
+
+    soa_vector<float,A> w(z);
+    REQUIRE(w.size() == z.size());
+    for (std::size_t i=0;i<w.size();++i) REQUIRE(w.get(i) == z.get(i));
+    soa_vector<float,A> v(std::move(w));
+    REQUIRE(w.empty());
+    REQUIRE(v.size() == z.size());
+    v.resize(3);
+    REQUIRE(v.size() == 3);
+    REQUIRE(std::vector<float>(v.begin(), v.end()) == std::vector<float>({2.f,2.f,2.f}));
+  }
+}
+
+// integer division, which only the generic targets have. the lanes past size() hold zero and must not be divided by
+template <class A> void soa_vector_division_test() {
+  SECTION(type<A>() + " division") {
+    soa_vector<std::int32_t,A> a(37, 10), b(37, 3);
+    a /= b;
+    for (int i=0;i<37;++i) REQUIRE(a.get(i) == 3);
+    a %= soa_vector<std::int32_t,A>(37, 2);
+    for (int i=0;i<37;++i) REQUIRE(a.get(i) == 1);
+  }
+}
+
+// integer / and % through every plain evaluation path. the tail is evaluated under last_mask, so the zero lanes
+// past size() must not reach the divisor
+template <class A> void soa_vector_quotient_test() {
+  SECTION(type<A>() + " quotient") {
+    soa_vector<std::int32_t,A> x(37, 10), y(37, 3);
+    soa_vector<std::int32_t,A> z(37, x / y);
+    for (int i=0;i<37;++i) REQUIRE(z.get(i) == 3);
+    z = x % y;
+    for (int i=0;i<37;++i) REQUIRE(z.get(i) == 1);
+    stream_assign(z, x / (y - z));
+    for (int i=0;i<37;++i) REQUIRE(z.get(i) == 5);
+    unrolled_assign<2>(z, x % (y + y));
+    for (int i=0;i<37;++i) REQUIRE(z.get(i) == 4);
+    blocked_assign(z, x / z, 2);
+    for (int i=0;i<37;++i) REQUIRE(z.get(i) == 2);
+    par_assign(z, x / (x - y), 8);
+    for (int i=0;i<37;++i) REQUIRE(z.get(i) == 1);
+    soa_vector<std::int32_t,A> q(37), r(37);
+    assign(std::tie(q, r), x / y, x % y);
+    for (int i=0;i<37;++i) REQUIRE((q.get(i) == 3 && r.get(i) == 1));
+  }
+}
+
+TEST_CASE("soa_vector", "[soa]") {
+  soa_vector_test<target::generic<1>>();
+  soa_vector_test<target::generic<4>>();
+  soa_vector_division_test<target::generic<1>>();
+  soa_vector_division_test<target::generic<4>>();
+  soa_vector_quotient_test<target::generic<1>>();
+  soa_vector_quotient_test<target::generic<4>>();
+#ifdef __AVX__
+  soa_vector_test<target::avx_4>();
+  soa_vector_test<target::avx_8>();
+  soa_vector_quotient_test<target::avx_4>();
+  soa_vector_quotient_test<target::avx_8>();
+#endif
+#ifdef __AVX2__
+  soa_vector_test<target::avx2_8>();
+  soa_vector_quotient_test<target::avx2_8>();
+#endif
+}
+
+template <class A, class L> void soa_table_test() {
+  SECTION(type<A>() + " " + type<L>()) {
+    using row = std::tuple<std::int32_t,float,float>;
+    const int w = A::width;
+    soa_table<row,A,L> t;
+    for (int i=0;i<29;++i) t.push_back(row(i, i * 0.5f, 1.f));
+    REQUIRE(t.size() == 29);
+    REQUIRE(t.get(3) == row(3, 1.5f, 1.f));
+
+    t.template field<2>() = field<1>(t) + field<1>(t) + field<2>(t);
+    for (int i=0;i<29;++i) REQUIRE(std::get<2>(t.get(i)) == i + 1.f);
+    field<1>(t) *= field<2>(t);
+    for (int i=0;i<29;++i) REQUIRE(std::get<1>(t.get(i)) == i * 0.5f * (i + 1.f));
+
+    vec<row,A> v = t.vget(1);
+    for (int i=0;i<A::width;++i) REQUIRE(std::get<0>(v.get(i)) == w + i);
+    t.vref(0) = v;
+    REQUIRE(std::get<0>(t.get(0)) == w);
+    t.put(0, row(-1, 0.f, 0.f));
+    REQUIRE(t.get(0) == row(-1, 0.f, 0.f));
+    t.push_back(v);
+    REQUIRE(t.size() == std::size_t(29 + A::width));
+    REQUIRE(std::get<0>(t.get(29)) == w);
+  }
+}
+
+// integer division, which only the generic targets have. the rows past size() hold zero and must not be divided by
+template <class A, class L> void soa_table_division_test() {
+  SECTION(type<A>() + " " + type<L>() + " division") {
+    using row = std::tuple<std::int32_t,std::int32_t>;
+    soa_table<row,A,L> t;
+    for (int i=0;i<37;++i) t.push_back(row(10 * i, 3));
+    t.template field<0>() /= t.template field<1>();
+    for (int i=0;i<37;++i) REQUIRE(std::get<0>(t.get(i)) == 10 * i / 3);
+    t.template field<0>() %= t.template field<1>();
+    for (int i=0;i<37;++i) REQUIRE(std::get<0>(t.get(i)) == 10 * i / 3 % 3);
+  }
+}
+
+template <class L> void soa_table_layout_test() {
+  soa_table_test<target::generic<1>,L>();
+  soa_table_test<target::generic<4>,L>();
+  soa_table_division_test<target::generic<1>,L>();
+  soa_table_division_test<target::generic<4>,L>();
+#ifdef __AVX__
+  soa_table_test<target::avx_4,L>();
+  soa_table_test<target::avx_8,L>();
+#endif
+#ifdef __AVX2__
+  soa_table_test<target::avx2_8,L>();
+#endif
+}
+
+TEST_CASE("soa_table", "[soa]") {
+  soa_table_layout_test<layout::soa>();
+  soa_table_layout_test<layout::aosoa>();
+}
+
+template <class A> void par_assign_test(worker_pool & pool) {
+  SECTION(type<A>()) {
+    const std::size_t n = 10007;
+    soa_vector<float,A> x(n), y(n, 2.f), z(n, -1.f);
+    for (std::size_t i=0;i<n;++i) x.put(i, float(i));
+    par_assign(z, x * y + x, 100, pool);
+    for (std::size_t i=0;i<n;++i) REQUIRE(z.get(i) == 3.f * float(i));
+    par_assign(z, x - x, 0, pool);
+    for (std::size_t i=0;i<n;++i) REQUIRE(z.get(i) == 0.f);
+    for (std::size_t i=n;i<std::size_t(z.vsize()) * A::width;++i) REQUIRE(z.vget(int(i / A::width)).get(int(i % A::width)) == 0.f);
+
+    soa<float,1000,A> a, b;
+    for (int i=0;i<1000;++i) a.put(i, float(i));
+    par_assign(b, a * a, 16, pool);
+    for (int i=0;i<1000;++i) REQUIRE(b.get(i) == float(i) * float(i));
+  }
+}
+
+TEST_CASE("par_assign", "[soa]") {
+  worker_pool pool(3);
+  REQUIRE(pool.size() == 3);
+
+  std::vector<int> seen(1000, 0);
+  pool.parallel_for(seen.size(), [&](std::size_t i) {
+    pool.parallel_for(2, [&](std::size_t j) { seen[i] += int(j) + 1; }); // nested loops run inline
+  });
+  for (int s : seen) REQUIRE(s == 3);
+  REQUIRE_THROWS_AS(pool.parallel_for(100, [](std::size_t i) { if (i == 42) throw std::runtime_error("42"); }), std::runtime_error);
+
+  // back to back short loops, each with its own function, so a worker that wakes late must not run a stale one
+  std::vector<int> ran(3, 0);
+  for (int k=0;k<20000;++k) {
+    const std::size_t n = 2 + std::size_t(k & 1);
+    std::vector<int> once(n, 0);
+    pool.parallel_for(n, [&](std::size_t i) { ++once[i]; });
+    for (std::size_t i=0;i<n;++i) ran[i] += once[i];
+  }
+  REQUIRE(ran[0] == 20000);
+  REQUIRE(ran[1] == 20000);
+  REQUIRE(ran[2] == 10000);
+
+  par_assign_test<target::generic<1>>(pool);
+  par_assign_test<target::generic<4>>(pool);
+#ifdef __AVX__
+  par_assign_test<target::avx_4>(pool);
+  par_assign_test<target::avx_8>(pool);
+#endif
+#ifdef __AVX2__
+  par_assign_test<target::avx2_8>(pool);
+#endif
+}
+
+template <class A> void reduce_test() {
+  SECTION(type<A>()) {
+    for (std::size_t n : { std::size_t(0), std::size_t(1), std::size_t(7), std::size_t(33), std::size_t(1000) }) {
+      soa_vector<float,A> x(n), y(n, 2.f);
+      soa_vector<std::int32_t,A> k(n);
+      for (std::size_t i=0;i<n;++i) { x.put(i, float(i)); k.put(i, std::int32_t(i % 7) - 3); }
+      const float s = float(n) * float(n - 1) / 2;
+
+      REQUIRE(sum(x) == s);
+      REQUIRE(sum(x + y) == s + 2.f * n); // the tail lanes of x + y are 2, and must not be counted
+      REQUIRE(kahan_sum(x) == s);
+      REQUIRE(dot(x, y) == 2.f * s);
+      REQUIRE(count(x < y) == std::min<std::size_t>(n, 2));
+      REQUIRE(count(x >= x) == n);
+      REQUIRE(any(x > y) == (n > 3));
+      REQUIRE(all(x < y + y) == (n <= 4));
+      REQUIRE(all(x == x));
+      if (n == 0) {
+        REQUIRE(min(x) == std::numeric_limits<float>::infinity());
+        REQUIRE(max(k) == std::numeric_limits<std::int32_t>::lowest());
+      } else {
+        REQUIRE(min(x) == 0.f);
+        REQUIRE(max(x) == float(n - 1));
+        REQUIRE(min(-x) == -float(n - 1));
+        REQUIRE(min(k) == -3);
+        REQUIRE(max(k) == std::int32_t(std::min<std::size_t>(n - 1, 6)) - 3);
+        REQUIRE(sum(k * k) >= 0);
+      }
+    }
+
+    // compensation keeps the small terms that a plain float sum rounds away
+    soa_vector<float,A> z(4096, 1e-4f);
+    z.put(0, 1e4f);
+    REQUIRE(kahan_sum(z) == Approx(1e4 + 4095 * 1e-4).epsilon(1e-6));
+    REQUIRE(kahan_sum(z) > sum(z));
+
+    soa<float,50,A> a(1.f);
+    REQUIRE(sum(a + a) == 100.f);
+    REQUIRE(count(a == a) == 50);
+  }
+}
+
+TEST_CASE("reduce", "[soa]") {
+  reduce_test<target::generic<1>>();
+  reduce_test<target::generic<4>>();
+#ifdef __AVX__
+  reduce_test<target::avx_4>();
+  reduce_test<target::avx_8>();
+#endif
+#ifdef __AVX2__
+  reduce_test<target::avx2_8>();
+#endif
+}
+
+template <class A> void let_test() {
+  SECTION(type<A>()) {
+    soa_vector<float,A> x(23), y(23, 2.f), a(23), b(23);
+    for (int i=0;i<23;++i) x.put(i, float(i));
+    a = let(x * y, [](auto t) { return t * t + t; });
+    for (int i=0;i<23;++i) REQUIRE(a.get(i) == 4.f * i * i + 2.f * i);
+    a = let(x + y, [&](auto t) { return let(t * t, [&y,t](auto u) { return u - t + y; }); }); // inner lets copy outer variables
+    for (int i=0;i<23;++i) REQUIRE(a.get(i) == (i + 2.f) * (i + 2.f) - (i + 2.f) + 2.f);
+    REQUIRE(sum(let(x, [](auto t) { return t + t; })) == 2.f * 253.f);
+    b = map(x + y, [](const vec<float,A> & v) { return v * v; });
+    for (int i=0;i<23;++i) REQUIRE(b.get(i) == (i + 2.f) * (i + 2.f));
+
+    assign(std::tie(a, b), x + y, x - y);
+    for (int i=0;i<23;++i) {
+      REQUIRE(a.get(i) == i + 2.f);
+      REQUIRE(b.get(i) == i - 2.f);
+    }
+    assign(std::tie(a, b), b, a); // every expression is read before anything is stored
+    for (int i=0;i<23;++i) {
+      REQUIRE(a.get(i) == i - 2.f);
+      REQUIRE(b.get(i) == i + 2.f);
+    }
+
+    soa<float,19,A> p(1.f), q, r, s;
+    assign(std::tie(q, r, s), p + p, p * p, let(p + p, [](auto t) { return t * t; }));
+    for (int i=0;i<19;++i) {
+      REQUIRE(q.get(i) == 2.f);
+      REQUIRE(r.get(i) == 1.f);
+      REQUIRE(s.get(i) == 4.f);
+    }
+  }
+}
+
+TEST_CASE("let", "[soa]") {
+  let_test<target::generic<1>>();
+  let_test<target::generic<4>>();
+#ifdef __AVX__
+  let_test<target::avx_4>();
+  let_test<target::avx_8>();
+#endif
+#ifdef __AVX2__
+  let_test<target::avx2_8>();
+#endif
+}
+
+#ifndef _WIN32
+template <class A> void mapped_soa_test() {
+  SECTION(type<A>()) {
+    const char * path = "t_soa_mapped.bin";
+    {
+      map_options options;
+      options.populate = true;
+      auto x = mapped_soa<float,A>::create(path, 1001, options);
+      REQUIRE(x.size() == 1001);
+      REQUIRE(reinterpret_cast<std::uintptr_t>(x.vdata()) % A::alignment == 0);
+      for (int i=0;i<1001;++i) REQUIRE(x.get(i) == 0.f);
+      soa_vector<float,A> y(1001, 2.f);
+      x = y * y;
+      x += y;
+      x.flush();
+    }
+    {
+      mapped_soa<float,A> x(path);
+      REQUIRE(x.size() == 1001);
+      for (int i=0;i<1001;++i) REQUIRE(x.get(i) == 6.f);
+      REQUIRE(sum(x) == 6006.f);
+      soa_vector<float,A> z(1001, x - x);
+      REQUIRE(sum(z) == 0.f);
+    }
+    {
+      map_options options;
+      options.writable = true;
+      mapped_soa<float,A> x(path, options);
+      stream_assign(x, x + x);
+    }
+    REQUIRE(sum(mapped_soa<float,A>(path)) == 12012.f);
+    {
+      mapped_soa<float,A> x(path);
+      REQUIRE(!x.writable());
+      REQUIRE_THROWS_AS(x = x + x, std::system_error);
+      REQUIRE_THROWS_AS(x *= x, std::system_error);
+      REQUIRE_THROWS_AS(stream_assign(x, x + x), std::system_error);
+      REQUIRE(x.get(0) == 12.f);
+    }
+    REQUIRE(std::remove(path) == 0);
+    using mapped = mapped_soa<float,A>;
+    REQUIRE_THROWS_AS(mapped(path), std::system_error);
+  }
+}
+
+// integer division, which only the generic targets have. the lanes past the end of the file read as zero
+template <class A> void mapped_soa_division_test() {
+  SECTION(type<A>() + " division") {
+    const char * path = "t_soa_mapped_div.bin";
+    {
+      auto x = mapped_soa<std::int32_t,A>::create(path, 37);
+      x = soa_vector<std::int32_t,A>(37, 10);
+      x /= soa_vector<std::int32_t,A>(37, 3);
+      for (int i=0;i<37;++i) REQUIRE(x.get(i) == 3);
+      x %= soa_vector<std::int32_t,A>(37, 2);
+      for (int i=0;i<37;++i) REQUIRE(x.get(i) == 1);
+    }
+    REQUIRE(std::remove(path) == 0);
+  }
+}
+
+TEST_CASE("mapped_soa", "[soa]") {
+  mapped_soa_test<target::generic<1>>();
+  mapped_soa_test<target::generic<4>>();
+  mapped_soa_division_test<target::generic<1>>();
+  mapped_soa_division_test<target::generic<4>>();
+#ifdef __AVX__
+  mapped_soa_test<target::avx_4>();
+  mapped_soa_test<target::avx_8>();
+#endif
+#ifdef __AVX2__
+  mapped_soa_test<target::avx2_8>();
+#endif
+}
+#endif
+
+template <class A> void columnar_test() {
+  SECTION(type<A>()) {
+    const char * path = "t_soa_columnar.bin";
+    const int n = 1001;
+    soa_vector<float,A> x(n);
+    soa_vector<std::int32_t,A> sorted(n), noisy(n);
+    for (int i=0;i<n;++i) {
+      x.put(i, float(i) * 0.5f);
+      sorted.put(i, 3 * i - 1000);
+      noisy.put(i, (i * 7919) % 613 - 300);
+    }
+    {
+      columnar::writer w(path, 128);
+      w.add("x", x);
+      columnar::column_options packed;
+      packed.encoding = columnar::encoding::bitpack;
+      w.add("noisy", noisy, packed);
+      columnar::column_options delta;
+      delta.encoding = columnar::encoding::delta;
+      delta.stats = false;
+      w.add("sorted", sorted, delta);
+      w.add("raw", sorted);
+      REQUIRE_THROWS_AS(w.add("short", soa_vector<float,A>(3)), std::invalid_argument);
+      REQUIRE_THROWS_AS(w.add("x2", x, packed), std::invalid_argument);
+      w.close();
+    }
+    columnar::reader r(path);
+    REQUIRE(r.rows() == std::uint64_t(n));
+    REQUIRE(r.columns() == 4);
+    REQUIRE(r.blocks() == 8);
+    REQUIRE(r.find("sorted") == 2);
+    REQUIRE_THROWS_AS(r.find("missing"), std::out_of_range);
+
+    auto v = r.view<float,A>(r.find("x"));
+    REQUIRE(reinterpret_cast<std::uintptr_t>(&v.vget(0)) % A::alignment == 0);
+    REQUIRE(sum(v) == sum(x));
+    soa_vector<float,A> y(n, v + v);
+    for (int i=0;i<n;++i) REQUIRE(y.get(i) == float(i));
+    REQUIRE(r.stats<float>(0, 7) == std::make_pair(448.f, 500.f));
+    REQUIRE_THROWS_AS((r.view<float,A>(1)), std::invalid_argument);
+    REQUIRE(r.values<std::int32_t>(1) == nullptr);
+    REQUIRE(r.values<std::int32_t>(3)[n-1] == sorted.get(n-1));
+
+    const char * names[] = { "noisy", "sorted", "raw" };
+    for (const char * name : names) {
+      soa_vector<std::int32_t,A> z;
+      r.read(r.find(name), z);
+      REQUIRE(z.size() == std::size_t(n));
+      const soa_vector<std::int32_t,A> & expected = name[0] == 'n' ? noisy : sorted;
+      for (int i=0;i<n;++i) REQUIRE(z.get(i) == expected.get(i));
+    }
+    REQUIRE(r.stats<std::int32_t>(1, 0).first == -300);
+    REQUIRE_THROWS_AS(r.stats<std::int32_t>(2, 0), std::out_of_range);
+    REQUIRE_THROWS_AS(r.stats<float>(1, 0), std::invalid_argument);
+    REQUIRE(std::remove(path) == 0);
+    REQUIRE_THROWS_AS(columnar::reader(path), std::system_error);
+  }
+}
+
+TEST_CASE("columnar", "[soa]") {
+  columnar_test<target::generic<1>>();
+  columnar_test<target::generic<4>>();
+#ifdef __AVX__
+  columnar_test<target::avx_4>();
+  columnar_test<target::avx_8>();
+#endif
+#ifdef __AVX2__
+  columnar_test<target::avx2_8>();
+#endif
+  SECTION("overflowing row count") {
+    const char * path = "t_soa_columnar_rows.bin";
+    {
+      columnar::writer w(path);
+      columnar::column_options plain;
+      plain.stats = false;
+      w.add("x", soa_vector<float,target::generic<1>>(64, 1.f), plain);
+      w.close();
+    }
+    // 64 + 2^62 rows of 4 bytes wraps to the 256 bytes the column really holds
+    const std::uint64_t rows = 64 + (std::uint64_t(1) << 62);
+    std::FILE * f = std::fopen(path, "r+b");
+    REQUIRE(f != nullptr);
+    REQUIRE(std::fseek(f, long(offsetof(columnar::file_header, rows)), SEEK_SET) == 0);
+    REQUIRE(std::fwrite(&rows, sizeof(rows), 1, f) == 1);
+    std::fclose(f);
+    REQUIRE_THROWS_AS(columnar::reader(path), std::runtime_error);
+    REQUIRE(std::remove(path) == 0);
+  }
+}
+
+template <class A> void sort_test() {
+  SECTION(type<A>()) {
+    const int width = A::width;
+    vec<std::int32_t,A> v;
+    for (int i=0;i<width;++i) v.put(i, (i * 5 + 3) % width - width / 2);
+    vec<std::int32_t,A> sv = sort_lanes(v);
+    for (int i=1;i<width;++i) REQUIRE(sv.get(i-1) <= sv.get(i));
+    vec<std::pair<float,std::int32_t>,A> pv;
+    for (int i=0;i<width;++i) pv.put(i, std::make_pair(float(width - i) * 0.25f, i));
+    auto spv = sort_lanes(pv);
+    for (int i=0;i<width;++i) REQUIRE(spv.get(i) == std::make_pair(float(i + 1) * 0.25f, width - 1 - i));
+
+    const int sizes[] = { 0, 1, 7, 8, 63, 64, 65, 200, 1000, 4099 };
+    for (int n : sizes) {
+      soa_vector<float,A> x(n);
+      soa_vector<std::int32_t,A> y(n);
+      std::vector<float> fx(n);
+      std::vector<std::int32_t> fy(n);
+      std::uint32_t seed = 12345;
+      for (int i=0;i<n;++i) {
+        seed = seed * 1664525u + 1013904223u;
+        fx[i] = float(std::int32_t(seed >> 8) % 1000) * 0.5f;
+        fy[i] = std::int32_t(seed) >> 20; // plenty of duplicates
+        x.put(i, fx[i]);
+        y.put(i, fy[i]);
+      }
+      soa_vector<std::int32_t,A> ix = argsort(x), iy = argsort(y);
+      REQUIRE(ix.size() == std::size_t(n));
+      std::vector<bool> seen(n, false);
+      for (int i=0;i<n;++i) {
+        REQUIRE(!seen[ix.get(i)]);
+        seen[ix.get(i)] = true;
+        if (i) REQUIRE(fx[ix.get(i-1)] <= fx[ix.get(i)]);
+        if (i) REQUIRE(fy[iy.get(i-1)] <= fy[iy.get(i)]);
+      }
+      sort(x);
+      sort(y);
+      std::sort(fx.begin(), fx.end());
+      std::sort(fy.begin(), fy.end());
+      for (int i=0;i<n;++i) {
+        REQUIRE(x.get(i) == fx[i]);
+        REQUIRE(y.get(i) == fy[i]);
+      }
+    }
+
+    // NaNs sort last, and none of the other keys are lost or duplicated
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    vec<float,A> nv;
+    for (int i=0;i<width;++i) nv.put(i, i == width / 2 ? nan : float(width - i));
+    const vec<float,A> snv = sort_lanes(nv);
+    REQUIRE(std::isnan(snv.get(width - 1)));
+    for (int i=1;i<width - 1;++i) REQUIRE(snv.get(i-1) < snv.get(i));
+    for (int n : { 64, 200 }) {
+      soa_vector<float,A> x(n);
+      float total = 0.f;
+      for (int i=0;i<n;++i) {
+        const float f = float((i * 37) % 101);
+        x.put(i, i % 29 == 3 ? nan : f);
+        if (i % 29 != 3) total += f;
+      }
+      const int nans = (n - 4) / 29 + 1;
+      const soa_vector<float,A> original(x);
+      const soa_vector<std::int32_t,A> ix = argsort(x);
+      sort(x);
+      float sorted_total = 0.f;
+      for (int i=0;i<n - nans;++i) {
+        REQUIRE(!std::isnan(x.get(i)));
+        REQUIRE(!std::isnan(original.get(std::size_t(ix.get(i)))));
+        if (i) REQUIRE(x.get(i-1) <= x.get(i));
+        REQUIRE(original.get(std::size_t(ix.get(i))) == x.get(i));
+        sorted_total += x.get(i);
+      }
+      for (int i=n - nans;i<n;++i) {
+        REQUIRE(std::isnan(x.get(i)));
+        REQUIRE(ix.get(i) % 29 == 3);
+      }
+      REQUIRE(sorted_total == total);
+    }
+
+    const std::int32_t a[] = { 1, 3, 5, 7, 9, 11, 13, 15, 17, 19 }, b[] = { 0, 2, 4, 6, 8, 10, 12, 14, 16, 18 };
+    std::int32_t c[20];
+    merge_sorted(a, 10, b, 10, c);
+    for (int i=0;i<20;++i) REQUIRE(c[i] == i);
+  }
+}
+
+TEST_CASE("sort", "[soa]") {
+  sort_test<target::generic<1>>();
+  sort_test<target::generic<4>>();
+#ifdef __AVX__
+  sort_test<target::avx_4>();
+  sort_test<target::avx_8>();
+#endif
+#ifdef __AVX2__
+  sort_test<target::avx2_8>();
+#endif
+}
+
+template <class S, class I, class = void> struct viewable : std::false_type {};
+template <class S, class I> struct viewable<S,I,decltype(void(view(std::declval<S>(), std::declval<I>())))> : std::true_type {};
+
+template <class A> void view_test() {
+  SECTION(type<A>()) {
+    const int n = 1001;
+    soa_vector<float,A> x(n), w(n, 2.f);
+    soa_vector<std::int32_t,A> reversed(n), evens((n + 1) / 2);
+    for (int i=0;i<n;++i) {
+      x.put(i, float(i));
+      reversed.put(i, n - 1 - i);
+    }
+    for (int i=0;i<(n+1)/2;++i) evens.put(i, 2 * i);
+
+    soa_vector<float,A> y(n, view(x, reversed));
+    for (int i=0;i<n;++i) REQUIRE(y.get(i) == float(n - 1 - i));
+    REQUIRE(sum(view(x, reversed) * w) == 2.f * sum(x));
+    REQUIRE(view(x, evens).length() == std::size_t((n + 1) / 2));
+    REQUIRE(sum(view(x, evens)) == 250500.f);
+    REQUIRE(max(view(x, evens)) == 1000.f);
+
+    // a permutation of a selection, without materializing either
+    soa_vector<std::int32_t,A> back((n + 1) / 2);
+    for (int i=0;i<(n+1)/2;++i) back.put(i, (n + 1) / 2 - 1 - i);
+    soa_vector<float,A> z((n + 1) / 2, view(x, view(evens, back)) + view(x, evens));
+    for (int i=0;i<(n+1)/2;++i) REQUIRE(z.get(i) == float(n - 1));
+
+    const soa_vector<std::int32_t,A> order = argsort(y);
+    soa_vector<float,A> sorted(n, view(y, order));
+    for (int i=0;i<n;++i) REQUIRE(sorted.get(i) == float(i));
+    // a view refers to its source and its index, so a temporary container cannot be either
+    static_assert(!viewable<const soa_vector<float,A> &, soa_vector<std::int32_t,A>>::value, "view of a temporary index");
+    static_assert(!viewable<soa_vector<float,A>, const soa_vector<std::int32_t,A> &>::value, "view of a temporary source");
+    static_assert(!viewable<soa_vector<float,A>, decltype(reversed + reversed)>::value, "view of a temporary source");
+    static_assert(viewable<soa_vector<float,A> &, const soa_vector<std::int32_t,A> &>::value, "view of a named source");
+    static_assert(viewable<const soa_vector<float,A> &, decltype(reversed + reversed)>::value, "view of a named source");
+  }
+}
+
+TEST_CASE("soa_view", "[soa]") {
+  view_test<target::generic<1>>();
+  view_test<target::generic<4>>();
+#ifdef __AVX__
+  view_test<target::avx_4>();
+  view_test<target::avx_8>();
+#endif
+#ifdef __AVX2__
+  view_test<target::avx2_8>();
+#endif
+}
+
+template <class A> void filter_test() {
+  SECTION(type<A>()) {
+    const int sizes[] = { 0, 1, 7, 8, 9, 1001 };
+    for (int n : sizes) {
+      soa_vector<float,A> x(n), t(n, 0.f), y;
+      soa_vector<std::int32_t,A> k(n), z;
+      for (int i=0;i<n;++i) {
+        x.put(i, float((i * 37) % 11) - 5.f);
+        k.put(i, i);
+      }
+      std::vector<float> expected;
+      std::vector<std::int32_t> indices;
+      for (int i=0;i<n;++i)
+        if (x.get(i) > 0.f) { expected.push_back(x.get(i)); indices.push_back(i); }
+
+      REQUIRE(filter(y, x, x > t) == expected.size());
+      REQUIRE(y.size() == expected.size());
+      for (std::size_t i=0;i<expected.size();++i) REQUIRE(y.get(i) == expected[i]);
+      if (y.vsize()) for (int j=int(y.size() & (A::width - 1));j && j<A::width;++j) REQUIRE(y.vget(y.vsize() - 1).get(j) == 0.f);
+
+      REQUIRE(select(z, x > t) == indices.size());
+      for (std::size_t i=0;i<indices.size();++i) REQUIRE(z.get(i) == indices[i]);
+      REQUIRE(sum(view(x, z)) == sum(y));
+
+      soa_vector<std::int32_t,A> p;
+      REQUIRE(partition(p, k, x > t) == indices.size());
+      REQUIRE(p.size() == std::size_t(n));
+      std::size_t j = 0;
+      for (;j<indices.size();++j) REQUIRE(p.get(j) == indices[j]);
+      for (int i=0;i<n;++i) if (!(x.get(i) > 0.f)) REQUIRE(p.get(j++) == i);
+    }
+  }
+}
+
+TEST_CASE("filter", "[soa]") {
+  filter_test<target::generic<1>>();
+  filter_test<target::generic<4>>();
+#ifdef __AVX__
+  filter_test<target::avx_4>();
+  filter_test<target::avx_8>();
+#endif
+#ifdef __AVX2__
+  filter_test<target::avx2_8>();
+#endif
+}
+
 TEST_CASE("soa", "[soa]") {
   arch_test<target::generic<1>>();
 #ifdef __AVX__
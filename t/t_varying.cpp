@@ -0,0 +1,637 @@
+#define CATCH_CONFIG_MAIN
+#include "rts/platform.hpp"
+#include "catch.hpp"
+#include "rts.hpp"
+#include "type.hpp"
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+using namespace rts;
+
+// each lane holds a + b * its index
+template <class T, class A> varying<T,A> lanes(T a, T b) {
+  varying<T,A> result;
+  for (int i=0;i<A::width;++i) result.put(i, a + b * T(i));
+  return result;
+}
+
+template <class A> void require_full_mask() {
+  const std::uint32_t m = A::width_mask;
+  REQUIRE(movemask(execution_mask<A>) == m);
+}
+
+static int collatz(std::int32_t n) {
+  int steps = 0;
+  for (;n != 1;++steps) n = n & 1 ? 3 * n + 1 : n / 2;
+  return steps;
+}
+
+template <class A> void control_test() {
+  SECTION(type<A>()) {
+    const auto x = lanes<std::int32_t,A>(0, 1);
+
+    SECTION("if_") {
+      varying<std::int32_t,A> y = 0;
+      if_(x < 2, [&] { y = 10; }, [&] { y = x; });
+      for (int i=0;i<A::width;++i) REQUIRE(y.get(i) == (i < 2 ? 10 : i));
+      require_full_mask<A>();
+    }
+
+    SECTION("coherent") {
+      const std::uint32_t full = A::width_mask;
+      std::uint32_t seen = 0;
+      int runs = 0;
+      // every lane agrees, so the branch runs under the mask it was called with
+      if_(x >= 0, [&] { seen = movemask(execution_mask<A>); ++runs; }, [&] { ++runs; });
+      REQUIRE(seen == full);
+      REQUIRE(runs == 1);
+      cif_(x < 0, [&] { ++runs; }, [&] { seen = movemask(execution_mask<A>); });
+      REQUIRE(seen == full);
+      REQUIRE(runs == 1);
+      // with no lane active, neither branch runs
+      if_(x < 0, [&] {
+        if_(x >= 0, [&] { ++runs; }, [&] { ++runs; });
+        cif_(x >= 0, [&] { ++runs; }, [&] { ++runs; });
+      });
+      REQUIRE(runs == 1);
+      varying<std::int32_t,A> y = 0, z = 0;
+      cif_(x < 2, [&] { y = 10; z = 1; }, [&] { y = x; });
+      if_(x == 0, [&] { cif_(x == 0, [&] { seen = movemask(execution_mask<A>); }); });
+      REQUIRE(seen == 1);
+      for (int i=0;i<A::width;++i) {
+        REQUIRE(y.get(i) == (i < 2 ? 10 : i));
+        REQUIRE(z.get(i) == (i < 2 ? 1 : 0));
+      }
+      require_full_mask<A>();
+    }
+
+    SECTION("while_") {
+      varying<std::int32_t,A> n = lanes<std::int32_t,A>(7, 3), steps = 0;
+      while_([&] { return n != 1; }, [&] {
+        if_((n & 1) == 1, [&] { n = n * 3 + 1; }, [&] { n = n / 2; });
+        steps += 1;
+      });
+      for (int i=0;i<A::width;++i) {
+        REQUIRE(n.get(i) == 1);
+        REQUIRE(steps.get(i) == collatz(7 + 3 * i));
+      }
+      require_full_mask<A>();
+    }
+
+    SECTION("newton") {
+      const auto a = lanes<float,A>(2.f, 3.f);
+      varying<float,A> r = a;
+      while_([&] { return (r * r - a > 1e-5f * a) | (a - r * r > 1e-5f * a); }, [&] { r = (r + a / r) * 0.5f; });
+      for (int i=0;i<A::width;++i) REQUIRE(std::fabs(r.get(i) - std::sqrt(2.f + 3.f * float(i))) < 1e-3f);
+      require_full_mask<A>();
+    }
+
+    SECTION("break_") {
+      varying<std::int32_t,A> i = 0;
+      const auto limit = x * 3;
+      while_([&] { return i < 100; }, [&] {
+        if_(i == limit, [&] { break_<A>(); });
+        i += 1;
+      });
+      for (int k=0;k<A::width;++k) REQUIRE(i.get(k) == 3 * k);
+      require_full_mask<A>();
+    }
+
+    SECTION("continue_") {
+      varying<std::int32_t,A> i, sum = 0;
+      const auto bound = x + 10;
+      for_([&] { i = 0; }, [&] { return i < bound; }, [&] { i += 1; }, [&] {
+        if_((i & 1) == 0, [&] { continue_<A>(); });
+        sum += i;
+      });
+      for (int k=0;k<A::width;++k) {
+        int expected = 0;
+        for (int j=1;j<10+k;j+=2) expected += j;
+        REQUIRE(sum.get(k) == expected);
+        REQUIRE(i.get(k) == 10 + k);
+      }
+      require_full_mask<A>();
+    }
+
+    SECTION("nested") {
+      varying<std::int32_t,A> j, i, count = 0;
+      for_([&] { j = 0; }, [&] { return j < 3; }, [&] { j += 1; }, [&] {
+        i = 0;
+        while_([&] { return i < 100; }, [&] {
+          if_(i == x, [&] { break_<A>(); });
+          count += 1;
+          i += 1;
+        });
+      });
+      for (int k=0;k<A::width;++k) {
+        REQUIRE(j.get(k) == 3);
+        REQUIRE(count.get(k) == 3 * k);
+      }
+      require_full_mask<A>();
+    }
+
+    SECTION("do_while_") {
+      varying<std::int32_t,A> k = 0;
+      do_while_([&] { k += 1; }, [&] { return k < x; });
+      for (int i=0;i<A::width;++i) REQUIRE(k.get(i) == (i < 1 ? 1 : i));
+      require_full_mask<A>();
+    }
+
+    SECTION("return_") {
+      varying<std::int32_t,A> y = 0, calls = 0;
+      function_<A>([&] {
+        calls += 1;
+        if_(x > 2, [&] {
+          y = 1;
+          return_<A>();
+        });
+        while_([&] { return y < 5; }, [&] {
+          if_(x == 1, [&] { return_<A>(); });
+          y += 2;
+        });
+      });
+      for (int i=0;i<A::width;++i) {
+        REQUIRE(calls.get(i) == 1);
+        REQUIRE(y.get(i) == (i > 2 ? 1 : i == 1 ? 0 : 6));
+      }
+      require_full_mask<A>();
+    }
+  }
+}
+
+TEST_CASE("control", "[varying]") {
+  control_test<target::generic<1>>();
+  control_test<target::generic<4>>();
+#ifdef __AVX__
+  control_test<target::avx_4>();
+  control_test<target::avx_8>();
+#endif
+#ifdef __AVX2__
+  control_test<target::avx2_8>();
+#endif
+}
+
+template <class A> void foreach_test() {
+  SECTION(type<A>()) {
+    SECTION("foreach") {
+      for (int n : {0, 1, A::width - 1, A::width, 3 * A::width + 1, 50}) {
+        const std::int32_t lo = 3, hi = lo + n;
+        std::vector<int> hits(std::size_t(hi), 0);
+        int full = 0, steps = 0;
+        varying<std::int32_t,A> sum = 0;
+        foreach<A>(lo, hi, [&](varying<std::int32_t,A> i) {
+          ++steps;
+          if (all(execution_mask<A>)) ++full;
+          foreach_active(execution_mask<A>, [&](int l) { ++hits[std::size_t(i.get(l))]; });
+          sum += i;
+        });
+        for (std::int32_t i=0;i<hi;++i) REQUIRE(hits[std::size_t(i)] == (i >= lo ? 1 : 0));
+        REQUIRE(full == n / A::width);
+        REQUIRE(steps == (n + A::width - 1) / A::width);
+        std::int32_t total = 0;
+        for (int l=0;l<A::width;++l) total += sum.get(l);
+        REQUIRE(total == (lo + hi - 1) * n / 2);
+        require_full_mask<A>();
+      }
+    }
+
+    SECTION("continue_") {
+      varying<std::int32_t,A> sum = 0;
+      foreach<A>(0, 37, [&](varying<std::int32_t,A> i) {
+        if_((i & 1) == 1, [&] { continue_<A>(); });
+        sum += i;
+      });
+      std::int32_t total = 0;
+      for (int l=0;l<A::width;++l) total += sum.get(l);
+      REQUIRE(total == 18 * 19);
+      require_full_mask<A>();
+    }
+
+    SECTION("under a mask") {
+      int visits = 0;
+      const auto x = lanes<std::int32_t,A>(0, 1);
+      if_(x == 0, [&] {
+        foreach<A>(0, 2 * A::width, [&](varying<std::int32_t,A>) { visits += popcnt(movemask(execution_mask<A>)); });
+        REQUIRE(movemask(execution_mask<A>) == 1);
+      });
+      REQUIRE(visits == 2 * A::width);
+      require_full_mask<A>();
+    }
+
+    SECTION("foreach_tiled 2d") {
+      const int nx = 13, ny = 7;
+      std::vector<int> hits(nx * ny, 0);
+      foreach_tiled<A>(0, nx, 0, ny, [&](varying<std::int32_t,A> x, varying<std::int32_t,A> y) {
+        foreach_active(execution_mask<A>, [&](int l) {
+          REQUIRE(x.get(l) < nx);
+          REQUIRE(y.get(l) < ny);
+          ++hits[std::size_t(y.get(l) * nx + x.get(l))];
+        });
+      });
+      for (int h : hits) REQUIRE(h == 1);
+      require_full_mask<A>();
+    }
+
+    SECTION("foreach_tiled 3d") {
+      const int nx = 5, ny = 6, nz = 3;
+      std::vector<int> hits(nx * ny * nz, 0);
+      foreach_tiled<A>(0, nx, 0, ny, 0, nz, [&](varying<std::int32_t,A> x, varying<std::int32_t,A> y, varying<std::int32_t,A> z) {
+        foreach_active(execution_mask<A>, [&](int l) { ++hits[std::size_t((z.get(l) * ny + y.get(l)) * nx + x.get(l))]; });
+      });
+      for (int h : hits) REQUIRE(h == 1);
+      require_full_mask<A>();
+    }
+  }
+}
+
+TEST_CASE("foreach", "[varying]") {
+  foreach_test<target::generic<1>>();
+  foreach_test<target::generic<4>>();
+#ifdef __AVX__
+  foreach_test<target::avx_4>();
+  foreach_test<target::avx_8>();
+#endif
+#ifdef __AVX2__
+  foreach_test<target::avx2_8>();
+#endif
+}
+
+template <class A> void serial_test() {
+  SECTION(type<A>()) {
+    const auto x = lanes<std::int32_t,A>(0, 1);
+
+    SECTION("foreach_active") {
+      std::vector<int> seen;
+      varying<std::int32_t,A> y = -1;
+      if_(x != 1, [&] {
+        foreach_active<A>([&](int lane) {
+          REQUIRE(movemask(execution_mask<A>) == 1u << lane);
+          seen.push_back(lane);
+          y = x * 10;
+        });
+      });
+      std::vector<int> expected;
+      for (int i=0;i<A::width;++i) if (i != 1) expected.push_back(i);
+      REQUIRE(seen == expected);
+      for (int i=0;i<A::width;++i) REQUIRE(y.get(i) == (i != 1 ? i * 10 : -1));
+      int count = 0;
+      foreach_active(x > 0, [&](int lane) { REQUIRE(lane > 0); ++count; });
+      REQUIRE(count == int(A::width) - 1);
+      require_full_mask<A>();
+    }
+
+    SECTION("foreach_unique") {
+      const varying<std::int32_t,A> id = x - (x / 3) * 3;
+      int calls = 0;
+      std::uint32_t covered = 0;
+      varying<std::int32_t,A> out = -1;
+      if_(x != 2, [&] {
+        foreach_unique(id, [&](std::int32_t value, const vec<bool,A> & lanes) {
+          ++calls;
+          REQUIRE(movemask(execution_mask<A>) == movemask(lanes));
+          REQUIRE((covered & movemask(lanes)) == 0);
+          covered |= movemask(lanes);
+          foreach_active(lanes, [&](int lane) { REQUIRE(id.get(lane) == value); });
+          out = value * 100;
+        });
+      });
+      std::uint32_t ids = 0;
+      for (int i=0;i<A::width;++i) if (i != 2) ids |= 1u << (i % 3);
+      REQUIRE(calls == popcnt(ids));
+      for (int i=0;i<A::width;++i) {
+        REQUIRE(((covered >> i) & 1) == (i != 2 ? 1u : 0u));
+        REQUIRE(out.get(i) == (i != 2 ? (i % 3) * 100 : -1));
+      }
+      require_full_mask<A>();
+    }
+
+    SECTION("foreach_unique nan") {
+      varying<float,A> f = 1.f;
+      f.put(0, std::numeric_limits<float>::quiet_NaN());
+      if (A::width > 1) f.put(A::width - 1, std::numeric_limits<float>::quiet_NaN());
+      int calls = 0, lanes_seen = 0;
+      foreach_unique(f, [&](float, const vec<bool,A> & lanes) { ++calls; lanes_seen += popcnt(movemask(lanes)); });
+      const int width = A::width;
+      REQUIRE(calls == (width == 1 ? 1 : width == 2 ? 2 : 3));
+      REQUIRE(lanes_seen == width);
+      require_full_mask<A>();
+    }
+  }
+}
+
+TEST_CASE("serial", "[varying]") {
+  serial_test<target::generic<1>>();
+  serial_test<target::generic<4>>();
+#ifdef __AVX__
+  serial_test<target::avx_4>();
+  serial_test<target::avx_8>();
+#endif
+#ifdef __AVX2__
+  serial_test<target::avx2_8>();
+#endif
+}
+
+template <class A> void context_test() {
+  SECTION(type<A>()) {
+    const auto x = lanes<std::int32_t,A>(0, 1);
+    spmd_context<A> ctx;
+
+    SECTION("if_") {
+      varying<std::int32_t,A> y = 0;
+      int runs = 0;
+      ctx.if_(x >= 0, [&] { ++runs; ctx.assign(y, 5); }, [&] { ++runs; });
+      REQUIRE(runs == 1);
+      ctx.if_(x < 2, [&] { ctx.assign(y, 10); }, [&] { ctx.assign(y, x); });
+      for (int i=0;i<A::width;++i) REQUIRE(y.get(i) == (i < 2 ? 10 : i));
+      REQUIRE(all(ctx.mask));
+    }
+
+    SECTION("loops") {
+      varying<std::int32_t,A> n = lanes<std::int32_t,A>(7, 3), steps = 0;
+      ctx.while_([&] { return n != 1; }, [&] {
+        ctx.if_((n & 1) == 1, [&] { ctx.assign(n, n * 3 + 1); }, [&] { ctx.assign(n, n / 2); });
+        ctx.assign(steps, steps + 1);
+      });
+      for (int i=0;i<A::width;++i) REQUIRE(steps.get(i) == collatz(7 + 3 * i));
+
+      varying<std::int32_t,A> i, sum = 0;
+      ctx.for_([&] { ctx.assign(i, 0); }, [&] { return i < 100; }, [&] { ctx.assign(i, i + 1); }, [&] {
+        ctx.if_(i == x + 10, [&] { ctx.break_(); });
+        ctx.if_((i & 1) == 0, [&] { ctx.continue_(); });
+        ctx.assign(sum, sum + i);
+      });
+      for (int k=0;k<A::width;++k) {
+        int expected = 0;
+        for (int j=1;j<10+k;j+=2) expected += j;
+        REQUIRE(sum.get(k) == expected);
+        REQUIRE(i.get(k) == 10 + k);
+      }
+      REQUIRE(all(ctx.mask));
+    }
+
+    SECTION("foreach") {
+      varying<std::int32_t,A> sum = 0;
+      int full = 0;
+      ctx.foreach(0, 37, [&](varying<std::int32_t,A> i) {
+        if (all(ctx.mask)) ++full;
+        ctx.assign(sum, sum + i);
+      });
+      std::int32_t total = 0;
+      for (int l=0;l<A::width;++l) total += sum.get(l);
+      REQUIRE(total == 36 * 37 / 2);
+      REQUIRE(full == 37 / A::width);
+      REQUIRE(all(ctx.mask));
+    }
+
+    // the context never touches the thread_local mask
+    require_full_mask<A>();
+  }
+}
+
+TEST_CASE("spmd_context", "[varying]") {
+  context_test<target::generic<1>>();
+  context_test<target::generic<4>>();
+#ifdef __AVX__
+  context_test<target::avx_4>();
+  context_test<target::avx_8>();
+#endif
+#ifdef __AVX2__
+  context_test<target::avx2_8>();
+#endif
+}
+
+template <class A> void launch_test(worker_pool & pool) {
+  SECTION(type<A>()) {
+    const auto x = lanes<std::int32_t,A>(0, 1);
+
+    SECTION("launch") {
+      std::vector<std::int32_t> a(40, 0), b(7, 0);
+      std::vector<std::uint32_t> entry(47, 0);
+      task_group<A> tasks(pool);
+      // catch is not thread safe, so the tasks only record what they see
+      tasks.launch(40, [&](std::size_t index, std::size_t count) {
+        entry[index] = count == 40 ? movemask(execution_mask<A>) : 0;
+        varying<std::int32_t,A> sum = 0;
+        foreach<A>(0, std::int32_t(index) + 1, [&](varying<std::int32_t,A> i) { sum += i; });
+        std::int32_t total = 0;
+        for (int l=0;l<A::width;++l) total += sum.get(l);
+        a[index] = total;
+        // leave lanes switched off, which the next task on this thread must not see
+        execution_mask<A> = (x == 0).data;
+        break_<A>();
+      });
+      tasks.launch(7, [&](std::size_t index, std::size_t count) {
+        entry[40 + index] = movemask(execution_mask<A>);
+        b[index] = std::int32_t(index * count);
+        execution_mask<A> = false;
+      });
+      REQUIRE(tasks.pending() == 47);
+      // the calling thread runs tasks too, and still gets its own mask back
+      if_(x == 0, [&] {
+        tasks.sync();
+        REQUIRE(movemask(execution_mask<A>) == 1);
+      });
+      REQUIRE(tasks.pending() == 0);
+      const std::uint32_t full = A::width_mask;
+      for (std::size_t i=0;i<40;++i) REQUIRE(a[i] == std::int32_t(i * (i + 1) / 2));
+      for (std::size_t i=0;i<7;++i) REQUIRE(b[i] == std::int32_t(i * 7));
+      for (auto m : entry) REQUIRE(m == full);
+      require_full_mask<A>();
+    }
+
+    SECTION("launch errors") {
+      std::vector<int> ran(16, 0);
+      REQUIRE_THROWS_AS(launch<A>(16, [&](std::size_t index, std::size_t) {
+        ran[index] = 1;
+        if (index == 3) throw std::runtime_error("task");
+      }, pool), std::runtime_error);
+      REQUIRE(ran[3] == 1);
+      worker_pool serial(0);
+      int again = 0;
+      launch<A>(4, [&](std::size_t, std::size_t) { ++again; }, serial);
+      REQUIRE(again == 4);
+      require_full_mask<A>();
+    }
+  }
+}
+
+TEST_CASE("launch", "[varying]") {
+  worker_pool pool(3);
+  launch_test<target::generic<1>>(pool);
+  launch_test<target::generic<4>>(pool);
+#ifdef __AVX__
+  launch_test<target::avx_4>(pool);
+  launch_test<target::avx_8>(pool);
+#endif
+#ifdef __AVX2__
+  launch_test<target::avx2_8>(pool);
+#endif
+}
+
+template <class A> void atomic_test(worker_pool & pool) {
+  SECTION(type<A>()) {
+    using ivec = vec<std::int32_t,A>;
+    const int width = A::width;
+    const auto x = lanes<std::int32_t,A>(0, 1);
+    const vec<bool,A> all(true);
+
+    SECTION("atomic_add") {
+      std::vector<std::int32_t> cells(width, 5);
+      vec<std::int32_t*,A> p;
+      for (int i=0;i<width;++i) p.put(i, &cells[i]);
+      const ivec old = atomic_add(p, (x + 1).data, all);
+      for (int i=0;i<width;++i) {
+        REQUIRE(old.get(i) == 5);
+        REQUIRE(cells[i] == 6 + i);
+      }
+      // every lane on one counter: a single atomic, and each lane sees the lanes below it
+      std::int32_t counter = 10;
+      const ivec seen = atomic_add(vec<std::int32_t*,A>(&counter), ivec(1), all);
+      REQUIRE(counter == 10 + width);
+      for (int i=0;i<width;++i) REQUIRE(seen.get(i) == 10 + i);
+      float total = 0.f;
+      atomic_add(vec<float*,A>(&total), vec<float,A>(0.5f), all);
+      REQUIRE(total == 0.5f * float(width));
+    }
+
+    SECTION("atomic_add masked") {
+      std::vector<std::int32_t> cells(2, 0);
+      const vec<based_ptr<std::int32_t>,A> p(cells.data(), (x & 1).data);
+      // only the active lanes take part
+      if_(x < 3, [&] {
+        const varying<std::int32_t,A> old = atomic_add(p, x + 1);
+        // lane 2 sees what lane 0 added to the same cell
+        foreach_active(execution_mask<A>, [&](int l) { REQUIRE(old.get(l) == (l == 2 ? 1 : 0)); });
+      });
+      REQUIRE(cells[0] == (width > 2 ? 4 : 1));
+      REQUIRE(cells[1] == (width > 1 ? 2 : 0));
+      require_full_mask<A>();
+    }
+
+    SECTION("atomic_min and atomic_max") {
+      std::vector<std::int32_t> lo(2, 3), hi(2, 3);
+      const auto v = ((x * 7) & 7).data;
+      const ivec k = (x & 1).data;
+      const ivec before_lo = atomic_min(vec<based_ptr<std::int32_t>,A>(lo.data(), k), v, all);
+      const ivec before_hi = atomic_max(vec<based_ptr<std::int32_t>,A>(hi.data(), k), v, all);
+      std::int32_t expect_lo[2] = { 3, 3 }, expect_hi[2] = { 3, 3 };
+      for (int i=0;i<width;++i) {
+        REQUIRE(before_lo.get(i) == expect_lo[i & 1]);
+        REQUIRE(before_hi.get(i) == expect_hi[i & 1]);
+        expect_lo[i & 1] = std::min(expect_lo[i & 1], v.get(i));
+        expect_hi[i & 1] = std::max(expect_hi[i & 1], v.get(i));
+      }
+      for (int j=0;j<2;++j) {
+        REQUIRE(lo[j] == expect_lo[j]);
+        REQUIRE(hi[j] == expect_hi[j]);
+      }
+    }
+
+    SECTION("compare_exchange") {
+      // the lanes take turns on one cell, each expecting what the lane before it left
+      std::int32_t cell = 0;
+      const ivec seen = compare_exchange(vec<std::int32_t*,A>(&cell), x.data, (x + 1).data, all);
+      REQUIRE(cell == width);
+      for (int i=0;i<width;++i) REQUIRE(seen.get(i) == i);
+      // lanes expecting the wrong value fail and leave it alone
+      std::int32_t other = 1;
+      const ivec failed = compare_exchange(vec<std::int32_t*,A>(&other), ivec(0), ivec(9), all);
+      REQUIRE(other == 1);
+      for (int i=0;i<width;++i) REQUIRE(failed.get(i) == 1);
+    }
+
+    SECTION("atomic tasks") {
+      std::int32_t counter = 0;
+      std::vector<std::int32_t> histogram(4, 0);
+      launch<A>(32, [&](std::size_t, std::size_t) {
+        foreach<A>(0, 100, [&](varying<std::int32_t,A> i) {
+          atomic_add(vec<std::int32_t*,A>(&counter), varying<std::int32_t,A>(1));
+          atomic_add(vec<based_ptr<std::int32_t>,A>(histogram.data(), (i & 3).data), varying<std::int32_t,A>(1));
+        });
+      }, pool);
+      REQUIRE(counter == 3200);
+      for (auto h : histogram) REQUIRE(h == 800);
+    }
+  }
+}
+
+TEST_CASE("atomic", "[varying]") {
+  worker_pool pool(3);
+  atomic_test<target::generic<1>>(pool);
+  atomic_test<target::generic<4>>(pool);
+#ifdef __AVX__
+  atomic_test<target::avx_4>(pool);
+  atomic_test<target::avx_8>(pool);
+#endif
+#ifdef __AVX2__
+  atomic_test<target::avx2_8>(pool);
+#endif
+}
+
+template <class T, class A> void cross_lane_test() {
+  const int width = program_count<A>();
+  const auto x = lanes<T,A>(T(1), T(2));
+  const varying<std::int32_t,A> index = program_index<A>();
+  for (int i=0;i<width;++i) REQUIRE(index.get(i) == i);
+
+  for (int l=0;l<width;++l) {
+    const varying<T,A> b = broadcast(x, l);
+    for (int i=0;i<width;++i) REQUIRE(b.get(i) == x.get(l));
+  }
+  for (int k=-width;k<=2*width;++k) {
+    const varying<T,A> r = rotate(x, k);
+    for (int i=0;i<width;++i) REQUIRE(r.get(i) == x.get((((i + k) % width) + width) % width));
+  }
+  // reverse, and every lane from lane 1 when there is one
+  const varying<T,A> reversed = shuffle(x, varying<std::int32_t,A>(width - 1) - index);
+  for (int i=0;i<width;++i) REQUIRE(reversed.get(i) == x.get(width - 1 - i));
+  const varying<T,A> second = shuffle(x, varying<std::int32_t,A>(1 + width));
+  for (int i=0;i<width;++i) REQUIRE(second.get(i) == x.get(1 % width));
+
+  T total = T(0);
+  for (int i=0;i<width;++i) total += x.get(i);
+  REQUIRE(reduce_add(x) == total);
+  const varying<T,A> scan = exclusive_scan_add(x);
+  T running = T(0);
+  for (int i=0;i<width;++i) {
+    REQUIRE(scan.get(i) == running);
+    running += x.get(i);
+  }
+
+  // inactive lanes contribute nothing
+  if_((index & 1) == 0, [&] {
+    T even = T(0);
+    for (int i=0;i<width;i+=2) even += x.get(i);
+    REQUIRE(reduce_add(x) == even);
+    const varying<T,A> s = exclusive_scan_add(x);
+    T below = T(0);
+    for (int i=0;i<width;++i) {
+      REQUIRE(s.get(i) == below);
+      if (i % 2 == 0) below += x.get(i);
+    }
+  });
+  REQUIRE(reduce_add(x, vec<bool,A>(false)) == T(0));
+  require_full_mask<A>();
+}
+
+template <class A> void cross_lane_tests() {
+  SECTION(type<A>()) {
+    SECTION("int32_t") { cross_lane_test<std::int32_t,A>(); }
+    SECTION("float") { cross_lane_test<float,A>(); }
+  }
+}
+
+TEST_CASE("cross lane", "[varying]") {
+  cross_lane_tests<target::generic<1>>();
+  cross_lane_tests<target::generic<4>>();
+#ifdef __AVX__
+  cross_lane_tests<target::avx_4>();
+  cross_lane_tests<target::avx_8>();
+#endif
+#ifdef __AVX2__
+  cross_lane_tests<target::avx2_8>();
+#endif
+}
@@ -36,3 +36,140 @@ TEST_CASE("vec", "[vec]") {
 #endif
 
 }
+
+template <int K, class T, class A> void interleave_test() {
+  T in[K*A::width], out[K*A::width];
+  for (int j=0;j<K*A::width;++j) in[j] = T(j);
+  vec<T,A> v[K];
+  load_interleaved(v, in);
+  for (int i=0;i<A::width;++i)
+    for (int k=0;k<K;++k) REQUIRE(v[k].get(i) == T(i*K+k));
+  store_interleaved(out, v);
+  for (int j=0;j<K*A::width;++j) REQUIRE(out[j] == in[j]);
+}
+
+template <class A> void interleave_arch_test() {
+  SECTION(type<A>()) {
+    interleave_test<2,float,A>();
+    interleave_test<3,float,A>();
+    interleave_test<4,float,A>();
+    interleave_test<8,float,A>();
+    interleave_test<5,float,A>();
+    interleave_test<3,std::int32_t,A>();
+    interleave_test<8,std::int32_t,A>();
+
+    std::pair<std::int32_t,float> ps[A::width], qs[A::width];
+    std::tuple<float,std::int32_t,float> ts[A::width], us[A::width];
+    for (int i=0;i<A::width;++i) {
+      ps[i] = std::make_pair(i, i * 0.5f);
+      ts[i] = std::make_tuple(i * 2.f, -i, i * 3.f);
+    }
+    vec<std::pair<std::int32_t,float>,A> p;
+    vec<std::tuple<float,std::int32_t,float>,A> t;
+    load(p, ps);
+    load(t, ts);
+    for (int i=0;i<A::width;++i) {
+      REQUIRE(p.get(i) == ps[i]);
+      REQUIRE(t.get(i) == ts[i]);
+    }
+    store(qs, p);
+    store(us, t);
+    for (int i=0;i<A::width;++i) {
+      REQUIRE(qs[i] == ps[i]);
+      REQUIRE(us[i] == ts[i]);
+    }
+  }
+}
+
+TEST_CASE("interleave", "[vec]") {
+  interleave_arch_test<target::generic<4>>();
+#ifdef __AVX__
+  interleave_arch_test<target::avx_4>();
+  interleave_arch_test<target::avx_8>();
+#endif
+#ifdef __AVX2__
+  interleave_arch_test<target::avx2_8>();
+#endif
+}
+
+template <class T, class A> void based_test() {
+  SECTION(type<T>()) {
+    static T arena[256];
+    for (int i=0;i<256;++i) arena[i] = T(i * 2);
+    vec<based_ptr<T>,A> p(arena);
+    for (int i=0;i<A::width;++i) p.put(i, arena + (i * 29) % 200);
+    vec<T,A> u = load(p);
+    for (int i=0;i<A::width;++i) REQUIRE(u.get(i) == *p.get(i));
+    vec<T*,A> w = p.widen();
+    for (int i=0;i<A::width;++i) REQUIRE(w.get(i) == p.get(i));
+
+    const std::uint32_t all = A::width_mask;
+    auto q = p + 3;
+    REQUIRE(movemask(q - p == vec<std::int32_t,A>(3)) == all);
+    REQUIRE(movemask(p < q) == all);
+    REQUIRE(movemask(p == vec<based_ptr<T>,A>(arena + 5, q.offset - 8)) == all); // different base, same lanes
+
+    vec<bool,A> m(false);
+    m.put(0,true); m.put(A::width-1,true);
+    store(q, u, m);
+    vec<T,A> r = load(q, m);
+    REQUIRE(r.get(0) == u.get(0));
+    REQUIRE(r.get(A::width-1) == u.get(A::width-1));
+    store(q, u);
+    for (int i=0;i<A::width;++i) REQUIRE(*q.get(i) == u.get(i));
+  }
+}
+
+template <class A> void based_arch_test() {
+  SECTION(type<A>()) {
+    based_test<std::int32_t,A>();
+    based_test<float,A>();
+  }
+}
+
+TEST_CASE("based_ptr", "[vec]") {
+  based_arch_test<target::generic<4>>();
+#ifdef __AVX__
+  based_arch_test<target::avx_4>();
+  based_arch_test<target::avx_8>();
+#endif
+#ifdef __AVX2__
+  based_arch_test<target::avx2_8>();
+#endif
+}
+
+#ifdef __AVX2__
+template <class T> void gather_test(gather_strategy s) {
+  using A = target::avx2_8;
+  SECTION(type<T>()) {
+    alignas(32) static T table[64];
+    for (int i=0;i<64;++i) table[i] = T(i * 3);
+    gather_strategy saved = current_gather_strategy();
+    pin_gather_strategy(s);
+    vec<T*,A> scattered, clustered;
+    for (int i=0;i<A::width;++i) {
+      scattered.put(i, table + (i * 37) % 64);
+      clustered.put(i, table + 8 + (i * 5) % 16);
+    }
+    vec<T,A> u = load(scattered), v = load(clustered);
+    for (int i=0;i<A::width;++i) {
+      CHECK(u.get(i) == *scattered.get(i));
+      CHECK(v.get(i) == *clustered.get(i));
+    }
+    vec<T,A> w = load(scattered, vec<bool,A>(0x5au));
+    for (int i=0;i<A::width;++i)
+      CHECK(w.get(i) == ((0x5a >> i) & 1 ? *scattered.get(i) : T(0)));
+    pin_gather_strategy(saved);
+  }
+}
+
+TEST_CASE("gather", "[vec]") {
+  CHECK(current_gather_strategy() != gather_strategy::automatic);
+  for (gather_strategy s : { gather_strategy::hardware, gather_strategy::scalar, gather_strategy::permute }) {
+    SECTION(std::to_string(static_cast<int>(s))) {
+      gather_test<std::int32_t>(s);
+      gather_test<float>(s);
+    }
+  }
+}
+#endif